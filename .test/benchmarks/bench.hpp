@@ -0,0 +1,46 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+// Shared setup for the benchmark programs. Each benchmark is a standalone program: it measures its cases with PROFILE_SCOPE(),
+// then prints the statistics over the LaunchPad's backchannel UART (eUSCI_A1 on P4.3/P4.2, 9600 baud) and stops.
+
+#define HAL_PROFILING
+
+#include <msp430.h>
+
+#include "hal/gpio.hpp"
+#include "hal/blocking_uart.hpp"
+#include "hal/profiler.hpp"
+#include "hal/watchdog.hpp"
+
+using BenchUart = Uart<UART_A1>;
+
+#pragma vector=TIMER1_B1_VECTOR
+__interrupt void TIMER1_B1_ISR(void) {
+    Profiler::handleInterrupt();
+}
+
+/// Stop the watchdog, set up the UART, and start the profiler. MCLK and SMCLK are left at their 1.048576MHz defaults,
+/// so one profiler cycle is one CPU cycle.
+inline void benchInit() {
+    Watchdog::disable();
+    Pin<P4,3>().function(PinFunction::Primary);
+    Pin<P4,2>().function(PinFunction::Primary);
+    gpioUnlock();
+    BenchUart::init(ClockSource::Smclk, BaudConfig::defaultSmclk9600Baud(), ParityBit::Disabled);
+    __enable_interrupt();
+    Profiler::start();
+}
+
+/// Print every scope's statistics, then stop.
+inline void benchReport(const char* title) {
+    const char* c = title;
+    while (*c) {
+        BenchUart::writeByte(uint8_t(*c++));
+    }
+    BenchUart::write(reinterpret_cast<const uint8_t*>("\r\n"), 2);
+    Profiler::dump<BenchUart>();
+    while (1);
+}
+
+#endif /* BENCH_HPP */
@@ -0,0 +1,73 @@
+#include "bench.hpp"
+#include "hal/adc.hpp"
+
+// Compares the cost of starting an ADC conversion before and after the ADC was kept powered between conversions.
+// The "old" cases repeat what startConversion() used to do on every call: disable the ADC, select the channel, then enable and start it.
+
+Pin<P1,1> input; // ADC channel A1
+
+static const uint8_t iterations = 64;
+
+void main() {
+    benchInit();
+    input.function(PinFunction::Tertiary);
+    Adc::init(AdcClockSource::ModClk, AdcPredivider::_4, AdcClockDivider::_1, AdcSampleTime::_4);
+    Adc::blockingConversion(input);
+
+    for (uint8_t i = iterations; i > 0; i--) {
+        {
+            PROFILE_SCOPE("old start");
+            Adc::disable();
+            Adc::selectChannel(input);
+            Adc::startConversion(input);
+        }
+        while (Adc::isBusy());
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("old start to result");
+        Adc::disable();
+        Adc::selectChannel(input);
+        Adc::startConversion(input);
+        while (Adc::isBusy());
+    }
+
+    for (uint8_t i = iterations; i > 0; i--) {
+        {
+            PROFILE_SCOPE("startConversion, same channel");
+            Adc::startConversion(input);
+        }
+        while (Adc::isBusy());
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("startConversion to result, same channel");
+        Adc::startConversion(input);
+        while (Adc::isBusy());
+    }
+
+    for (uint8_t i = iterations; i > 0; i--) {
+        {
+            PROFILE_SCOPE("startConversion, channel change");
+            if (i & 1) {
+                Adc::startConversion(input);
+            } else {
+                Adc::startConversion(AdcChannel::VSS);
+            }
+        }
+        while (Adc::isBusy());
+    }
+
+    Adc::blockingConversion(input);
+    for (uint8_t i = iterations; i > 0; i--) {
+        {
+            PROFILE_SCOPE("retrigger");
+            Adc::retrigger();
+        }
+        while (Adc::isBusy());
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("blockingRetrigger");
+        Adc::blockingRetrigger();
+    }
+
+    benchReport("ADC conversion start, in CPU cycles");
+}
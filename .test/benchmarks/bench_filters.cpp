@@ -0,0 +1,84 @@
+#include "bench.hpp"
+#include "hal/filters.hpp"
+
+// Cycles per sample for each filter in filters.hpp. Each case times one update(), so the mean column is the cost of one sample.
+
+static const uint8_t iterations = 64;
+
+// The filters' results are written here, so the compiler can't drop the updates
+volatile uint16_t sink16;
+volatile int32_t sink32;
+
+// Low pass sections, which fit the format's own accumulator, and a high gain section, which makes Q15 widen to 64 bits
+using LowpassQ15 = Biquad<Q15, Biquad<Q15>::coeff(0.0675), Biquad<Q15>::coeff(0.1349), Biquad<Q15>::coeff(0.0675), Biquad<Q15>::coeff(-1.1430), Biquad<Q15>::coeff(0.4128)>;
+using LowpassQ31 = Biquad<Q31, Biquad<Q31>::coeff(0.0675), Biquad<Q31>::coeff(0.1349), Biquad<Q31>::coeff(0.0675), Biquad<Q31>::coeff(-1.1430), Biquad<Q31>::coeff(0.4128)>;
+using PeakQ15 = Biquad<Q15, Biquad<Q15>::coeff(1.9), Biquad<Q15>::coeff(-1.9), Biquad<Q15>::coeff(0.95), Biquad<Q15>::coeff(1.9), Biquad<Q15>::coeff(0.95)>;
+
+BoxcarFilter<16> boxcar;
+EmaFilter<4> ema;
+LowpassQ15 lowpassQ15;
+PeakQ15 peakQ15;
+LowpassQ31 lowpassQ31;
+MedianFilter<5> median5;
+MedianFilter<9> median9;
+CicDecimator<2, 8> cic2;
+CicDecimator<4, 16> cic4;
+
+/// A repeatable sawtooth with some jitter, like a noisy ADC reading.
+static uint16_t sample(uint8_t i) {
+    return uint16_t(i) * 61u + ((i * 37u) & 0x1F);
+}
+
+void main() {
+    benchInit();
+
+    for (uint8_t i = iterations; i > 0; i--) {
+        uint16_t x = sample(i);
+        PROFILE_SCOPE("BoxcarFilter<16>");
+        sink16 = boxcar.update(x);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        uint16_t x = sample(i);
+        PROFILE_SCOPE("EmaFilter<4>");
+        sink16 = ema.update(x);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        int16_t x = int16_t(sample(i) << 3);
+        PROFILE_SCOPE("Biquad Q15, 32-bit accumulator");
+        sink16 = uint16_t(lowpassQ15.update(x));
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        int16_t x = int16_t(sample(i) << 3);
+        PROFILE_SCOPE("Biquad Q15, 64-bit accumulator");
+        sink16 = uint16_t(peakQ15.update(x));
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        int32_t x = int32_t(sample(i)) << 19;
+        PROFILE_SCOPE("Biquad Q31");
+        sink32 = lowpassQ31.update(x);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        uint16_t x = sample(i);
+        PROFILE_SCOPE("MedianFilter<5>");
+        sink16 = median5.update(x);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        uint16_t x = sample(i);
+        PROFILE_SCOPE("MedianFilter<9>");
+        sink16 = median9.update(x);
+    }
+    // The mean includes the samples that only update the integrators
+    for (uint8_t i = iterations; i > 0; i--) {
+        uint16_t x = sample(i);
+        PROFILE_SCOPE("CicDecimator<2, 8>");
+        sink16 = cic2.update(x);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        uint16_t x = sample(i);
+        PROFILE_SCOPE("CicDecimator<4, 16>");
+        sink16 = cic4.update(x);
+    }
+    sink16 = cic2.output() + cic4.output();
+
+    benchReport("Filters, in CPU cycles per sample");
+}
@@ -0,0 +1,88 @@
+#include "bench.hpp"
+#include "hal/scheduler.hpp"
+#include "hal/timer_b.hpp"
+
+// Latency from an interrupt posting an event to the task's handler starting, in CPU cycles. Timer_B2 raises an event every 4096 cycles.
+// Its interrupt takes a timestamp and posts to the event task, which takes another as soon as it starts. The latency therefore includes
+// waking the CPU, returning from the interrupt, and the scheduler picking the task, but not the interrupt's own entry.
+//
+// The profiler counts SMCLK, which stops in LPM3, so the scheduler is held in LPM0 or LPM1 with limitSleep().
+
+void eventTask(uint16_t events);
+void busyTask(uint16_t events);
+
+using App = Scheduler<Tasks<&eventTask, &busyTask>>;
+using EventTimer = TimerB<TIMER_B2>;
+using EventConfig = TimerConfig<TimerClockSource::Smclk, TimerMode::Up, 1>;
+
+static const uint8_t iterations = 64;
+
+enum Phase : uint8_t {
+    /// The scheduler is asleep in LPM0 when the event arrives
+    SleepLpm0,
+    /// The scheduler is asleep in LPM1 when the event arrives
+    SleepLpm1,
+    /// A lower priority task is running when the event arrives, and must finish first
+    BehindBusyTask,
+    Done,
+};
+
+static ProfileStats lpm0Latency("post to handler, woken from LPM0");
+static ProfileStats lpm1Latency("post to handler, woken from LPM1");
+static ProfileStats busyLatency("post to handler, behind a 5000 cycle task");
+
+volatile uint32_t postedAt;
+static Phase phase = SleepLpm0;
+static uint8_t samples = 0;
+
+#pragma vector=TIMER2_B0_VECTOR
+__interrupt void TIMER2_B0_ISR(void) {
+    postedAt = Profiler::now();
+    if (App::post<0>(1)) {
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
+}
+
+void busyTask(uint16_t) {
+    // Longer than the event period, so the next event always arrives while this runs
+    __delay_cycles(5000);
+}
+
+void eventTask(uint16_t) {
+    uint32_t latency = Profiler::now() - postedAt;
+    static ProfileStats* const stats[] = {&lpm0Latency, &lpm1Latency, &busyLatency};
+    Profiler::record(*stats[phase], latency);
+
+    if (++samples == iterations) {
+        samples = 0;
+        switch (phase) {
+            case SleepLpm0:
+                App::limitSleep(LowPowerMode::Lpm1);
+                App::releaseSleep(LowPowerMode::Lpm0);
+                phase = SleepLpm1;
+                break;
+            case SleepLpm1:
+                phase = BehindBusyTask;
+                break;
+            default:
+                EventTimer::stop<EventConfig>();
+                phase = Done;
+                benchReport("Scheduler latency, in CPU cycles");
+        }
+    }
+    if (phase == BehindBusyTask) {
+        App::post<1>(1);
+    }
+}
+
+void main() {
+    benchInit();
+    App::limitSleep(LowPowerMode::Lpm0);
+
+    EventTimer::init<EventConfig>();
+    EventTimer::setPeriod(4096 - 1);
+    EventTimer::enableInterrupt<0>();
+    EventTimer::start<EventConfig>();
+
+    App::run();
+}
@@ -0,0 +1,81 @@
+#include "bench.hpp"
+#include "hal/delay.hpp"
+#include "hal/timer_wheel.hpp"
+
+// Cycle counts for the TimerWheel operations: schedule() and cancel(), which should be the same however many timers are scheduled,
+// and poll(), whose cost depends on how far it has to scan for the next expiry.
+
+#pragma vector=TIMER0_B1_VECTOR
+__interrupt void TIMER0_B1_ISR(void) {
+    if (Timebase::handleInterrupt()) {
+        __bic_SR_register_on_exit(LPM4_bits);
+    }
+}
+
+using Wheel = TimerWheel<>;
+
+static const uint8_t iterations = 32;
+
+static void onExpiry(SoftTimer&) {}
+
+SoftTimer timers[iterations];
+SoftTimer probe = {&onExpiry};
+
+void main() {
+    benchInit();
+    Timebase::start();
+    for (uint8_t i = 0; i < iterations; i++) {
+        timers[i].callback = &onExpiry;
+    }
+
+    // Far enough away that nothing expires during the benchmark. 60s is a whole number of turns of the default wheel (240 turns of 250ms),
+    // so a timer this far away lands in the current slot.
+    const uint32_t far = Timebase::ticksForMs(60000);
+
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("schedule, empty wheel");
+        Wheel::schedule(probe, far);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("cancel");
+        Wheel::cancel(probe);
+        Wheel::schedule(probe, far);
+    }
+    Wheel::cancel(probe);
+
+    // Spread timers around the wheel, then time the same operations again
+    for (uint8_t i = 0; i < iterations; i++) {
+        Wheel::schedule(timers[i], far + uint32_t(i) * Wheel::slotWidth);
+    }
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("schedule, 32 timers");
+        Wheel::schedule(probe, far);
+    }
+
+    // Nothing due, and the next occupied slot is the current one (or the next, if the count has moved on a slot)
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("poll, nothing due");
+        Wheel::poll();
+    }
+    for (uint8_t i = 0; i < iterations; i++) {
+        Wheel::cancel(timers[i]);
+    }
+
+    // One timer, half a turn away: the scan for the next occupied slot covers half of the bitmap
+    Wheel::cancel(probe);
+    Wheel::schedule(probe, far + (Wheel::slots / 2) * Wheel::slotWidth);
+    for (uint8_t i = iterations; i > 0; i--) {
+        PROFILE_SCOPE("poll, next slot half a turn away");
+        Wheel::poll();
+    }
+    Wheel::cancel(probe);
+
+    // A timer due now, run by poll()
+    for (uint8_t i = iterations; i > 0; i--) {
+        Wheel::schedule(probe, 0);
+        PROFILE_SCOPE("poll, one expiry");
+        Wheel::poll();
+    }
+
+    benchReport("TimerWheel, in CPU cycles");
+}
@@ -0,0 +1,41 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+
+// A minimal test harness: each failed CHECK prints where it failed, and checkResult() turns the count into the exit status.
+
+#include <stdio.h>
+#include <math.h>
+
+static int checkFailures = 0;
+
+// Variadic so that conditions containing template argument lists don't need extra parentheses
+#define CHECK(...) \
+    do { \
+        if (!(__VA_ARGS__)) { \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+            checkFailures++; \
+        } \
+    } while (0)
+
+/// Check that `actual` is within `tolerance` of `expected`, printing both if it isn't.
+#define CHECK_NEAR(actual, expected, tolerance) \
+    do { \
+        double checkActual_ = double(actual); \
+        double checkExpected_ = double(expected); \
+        if (!(fabs(checkActual_ - checkExpected_) <= double(tolerance))) { \
+            printf("%s:%d: CHECK_NEAR(%s, %s, %s) failed: %.9g vs %.9g\n", __FILE__, __LINE__, #actual, #expected, #tolerance, checkActual_, checkExpected_); \
+            checkFailures++; \
+        } \
+    } while (0)
+
+/// Print a summary, and return the process exit status.
+inline int checkResult(const char* suite) {
+    if (checkFailures != 0) {
+        printf("%s: %d check(s) failed\n", suite, checkFailures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", suite);
+    return 0;
+}
+
+#endif /* CHECK_HPP */
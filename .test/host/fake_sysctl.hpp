@@ -0,0 +1,38 @@
+#ifndef FAKE_SYSCTL_HPP
+#define FAKE_SYSCTL_HPP
+
+// Stands in for the SYS registers that ResetLog and FramWriteEnable use, for testing them without a device.
+// SYSRSTIV returns the values the test queued with queueResets(), then 0, like the real vector once every cause has been read.
+// Include this before the code under test, so the names below replace the real register definitions.
+
+#include <stdint.h>
+#include <deque>
+#include <initializer_list>
+
+#define FRWPPW      (0xA500)
+#define PFWP        (0x0001)
+#define DFWP        (0x0002)
+
+/// SYSCFG0 as last written, with the password byte. Starts with both FRAM areas protected, as after a reset.
+static uint16_t fakeSysCfg0 = PFWP | DFWP;
+static std::deque<uint16_t> fakeSysRstIv;
+
+static uint16_t readSysRstIv() {
+    if (fakeSysRstIv.empty()) {
+        return 0;
+    }
+    uint16_t iv = fakeSysRstIv.front();
+    fakeSysRstIv.pop_front();
+    return iv;
+}
+
+/// Set the values SYSRSTIV returns, in order, before it returns 0.
+static void queueResets(std::initializer_list<uint16_t> ivs) {
+    fakeSysRstIv.assign(ivs);
+}
+
+#define SYSCFG0     fakeSysCfg0
+#define SYSCFG0_L   uint8_t(fakeSysCfg0)
+#define SYSRSTIV    readSysRstIv()
+
+#endif /* FAKE_SYSCTL_HPP */
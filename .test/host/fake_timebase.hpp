@@ -0,0 +1,88 @@
+#ifndef FAKE_TIMEBASE_HPP
+#define FAKE_TIMEBASE_HPP
+
+// A Timebase whose tick count only moves when the test calls advanceTo(), for testing code built on the Timebase without Timer_B0.
+// Including this first stops delay.hpp (and with it the real Timebase) from being included.
+
+#include <stdint.h>
+
+#define DELAY_HPP
+
+struct Timebase {
+    private:
+    struct State {
+        uint32_t tick;
+        uint32_t alarmTick;
+        bool alarmArmed;
+        bool alarmFired;
+        /// Number of calls to setAlarm()
+        uint16_t alarmsSet;
+    };
+
+    static State& state() {
+        static State s = {};
+        return s;
+    }
+
+    public:
+    /// Start again from `tick`, with no alarm.
+    static void reset(uint32_t tick = 0) {
+        state() = State {};
+        state().tick = tick;
+    }
+
+    /// Move the tick count forward to `tick`, firing the alarm if it is reached on the way.
+    static void advanceTo(uint32_t tick) {
+        state().tick = tick;
+        if (state().alarmArmed && (int32_t(tick - state().alarmTick) >= 0)) {
+            state().alarmArmed = false;
+            state().alarmFired = true;
+        }
+    }
+
+    static uint16_t alarmsSet() {
+        return state().alarmsSet;
+    }
+
+    // The same interface as the real Timebase
+
+    static uint32_t now() {
+        return state().tick;
+    }
+
+    /// Like the real alarm, one set less than two ticks ahead fires two ticks from now.
+    static void setAlarm(uint32_t tick) {
+        uint32_t earliest = state().tick + 2;
+        if (int32_t(tick - earliest) < 0) {
+            tick = earliest;
+        }
+        state().alarmTick = tick;
+        state().alarmArmed = true;
+        state().alarmsSet++;
+    }
+
+    static void cancelAlarm() {
+        state().alarmArmed = false;
+        state().alarmFired = false;
+    }
+
+    static bool alarmArmed() {
+        return state().alarmArmed;
+    }
+
+    static uint32_t alarmTick() {
+        return state().alarmTick;
+    }
+
+    static bool alarmFired() {
+        return state().alarmFired;
+    }
+
+    static bool takeAlarm() {
+        bool fired = state().alarmFired;
+        state().alarmFired = false;
+        return fired;
+    }
+};
+
+#endif /* FAKE_TIMEBASE_HPP */
@@ -0,0 +1,27 @@
+#ifndef HOST_SHIM_MSP430_H
+#define HOST_SHIM_MSP430_H
+
+// Stands in for the compiler's msp430.h in host tests: the intrinsics the headers under test use, as no-ops.
+// Only headers that don't touch peripheral registers (or whose peripherals the test replaces) can be tested this way.
+
+#include <stdint.h>
+
+#define GIE         (0x0008)
+#define CPUOFF      (0x0010)
+#define OSCOFF      (0x0020)
+#define SCG0        (0x0040)
+#define SCG1        (0x0080)
+
+#define LPM0_bits   (CPUOFF)
+#define LPM1_bits   (SCG0 | CPUOFF)
+#define LPM3_bits   (SCG1 | SCG0 | CPUOFF)
+#define LPM4_bits   (SCG1 | SCG0 | OSCOFF | CPUOFF)
+
+inline uint16_t __get_interrupt_state() { return 0; }
+inline void __set_interrupt_state(uint16_t) {}
+inline void __disable_interrupt() {}
+inline void __enable_interrupt() {}
+inline void __bis_SR_register(uint16_t) {}
+inline void __bic_SR_register(uint16_t) {}
+
+#endif /* HOST_SHIM_MSP430_H */
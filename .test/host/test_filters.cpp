@@ -0,0 +1,215 @@
+// Compares each fixed-point filter in filters.hpp against a double-precision reference fed the same samples.
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+#include "check.hpp"
+#include "filters.hpp"
+
+/// A repeatable pseudo-random sequence (xorshift), so failures can be reproduced.
+struct Random {
+    uint32_t state = 2463534242u;
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    /// Uniform in [low, high].
+    int32_t range(int32_t low, int32_t high) {
+        return low + int32_t(next() % uint32_t(high - low + 1));
+    }
+};
+
+static const int sampleCount = 4000;
+
+static void testBoxcar() {
+    BoxcarFilter<8> filter;
+    std::vector<uint16_t> window(8, 0);
+    Random random;
+    for (int n = 0; n < sampleCount; n++) {
+        uint16_t sample = uint16_t(random.range(0, 4095));
+        window[n % 8] = sample;
+        double mean = 0;
+        for (uint16_t value : window) {
+            mean += value;
+        }
+        mean /= 8;
+        // The filter truncates the exact mean
+        CHECK(filter.update(sample) == uint16_t(floor(mean)));
+    }
+}
+
+static void testEma() {
+    EmaFilter<4> filter;
+    double reference = 0;
+    Random random;
+    for (int n = 0; n < sampleCount; n++) {
+        // A slow ramp with noise on top, so the average has something to follow
+        uint16_t sample = uint16_t(std::min(4095, n / 2 + random.range(0, 255)));
+        reference += (sample - reference) / 16;
+        // The extra fractional bits keep the rounding error within a count
+        CHECK_NEAR(filter.update(sample), reference, 1.0);
+    }
+}
+
+/// Direct form I biquad in double precision, with the filter's own quantised coefficients, saturating like the filter does.
+struct ReferenceBiquad {
+    double b0, b1, b2, a1, a2;
+    double min, max;
+    double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+    /// Largest magnitude of the sum of products, before saturation
+    double peakSum = 0;
+
+    double update(double x0) {
+        double y0 = b0 * x0 + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        peakSum = std::max(peakSum, fabs(y0));
+        y0 = std::max(min, std::min(max, y0));
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        return y0;
+    }
+};
+
+/// Feed `input` to a Q15 or Q31 biquad and to the double reference, and return the largest difference in units of the format's LSB.
+/// The reference's largest sum of products (as a real number) is stored in `peakSum`, if given.
+template<typename Filter, typename Format>
+static double biquadMaxError(const std::vector<double>& input, double b0, double b1, double b2, double a1, double a2, double* peakSum = nullptr) {
+    const double scale = double(int64_t(1) << Format::fracBits);
+    const double coeffScale = double(int64_t(1) << Filter::coeffFracBits);
+    ReferenceBiquad reference = {
+        double(Filter::coeff(b0)) / coeffScale, double(Filter::coeff(b1)) / coeffScale, double(Filter::coeff(b2)) / coeffScale,
+        double(Filter::coeff(a1)) / coeffScale, double(Filter::coeff(a2)) / coeffScale,
+        double(Format::min) / scale, double(Format::max) / scale,
+    };
+    Filter filter;
+    double maxError = 0;
+    for (double x : input) {
+        typename Format::Type sample = Format::from(x);
+        double expected = reference.update(double(sample) / scale);
+        double actual = double(filter.update(sample)) / scale;
+        maxError = std::max(maxError, fabs(actual - expected) * scale);
+    }
+    if (peakSum) {
+        *peakSum = reference.peakSum;
+    }
+    return maxError;
+}
+
+// 2nd order Butterworth low pass at 1/10 of the sample rate
+static constexpr double lpB0 = 0.0675, lpB1 = 0.1349, lpB2 = 0.0675, lpA1 = -1.1430, lpA2 = 0.4128;
+// A resonance at half the sample rate, whose coefficient magnitudes sum to well over 4
+static constexpr double pkB0 = 1.9, pkB1 = -1.9, pkB2 = 0.95, pkA1 = 1.9, pkA2 = 0.95;
+
+using LowpassQ15 = Biquad<Q15, Biquad<Q15>::coeff(lpB0), Biquad<Q15>::coeff(lpB1), Biquad<Q15>::coeff(lpB2), Biquad<Q15>::coeff(lpA1), Biquad<Q15>::coeff(lpA2)>;
+using LowpassQ31 = Biquad<Q31, Biquad<Q31>::coeff(lpB0), Biquad<Q31>::coeff(lpB1), Biquad<Q31>::coeff(lpB2), Biquad<Q31>::coeff(lpA1), Biquad<Q31>::coeff(lpA2)>;
+using PeakQ15 = Biquad<Q15, Biquad<Q15>::coeff(pkB0), Biquad<Q15>::coeff(pkB1), Biquad<Q15>::coeff(pkB2), Biquad<Q15>::coeff(pkA1), Biquad<Q15>::coeff(pkA2)>;
+
+static_assert(std::is_same<LowpassQ15::Acc, int32_t>::value, "A low pass section fits the 32-bit accumulator");
+static_assert(std::is_same<PeakQ15::Acc, int64_t>::value, "A high gain section must widen to 64 bits");
+
+static std::vector<double> noise(double amplitude) {
+    std::vector<double> input;
+    Random random;
+    for (int n = 0; n < sampleCount; n++) {
+        input.push_back(amplitude * (random.range(-32768, 32767) / 32768.0));
+    }
+    return input;
+}
+
+static void testBiquad() {
+    std::vector<double> input = noise(0.5);
+    // Steps, to exercise the settling
+    for (int n = 0; n < 200; n++) {
+        input.push_back(0.9);
+    }
+    for (int n = 0; n < 200; n++) {
+        input.push_back(-0.9);
+    }
+    // Rounding errors are fed back through the poles, so allow a few LSBs
+    CHECK(biquadMaxError<LowpassQ15, Q15>(input, lpB0, lpB1, lpB2, lpA1, lpA2) <= 4);
+    CHECK(biquadMaxError<LowpassQ31, Q31>(input, lpB0, lpB1, lpB2, lpA1, lpA2) <= 4);
+}
+
+static void testBiquadHeadroom() {
+    // Full scale input at the resonant frequency drives the sum of products past what 32 bits can hold (a real value of 4, as the
+    // products are Q29). A 32-bit accumulator would wrap around and flip the output's sign. The 64-bit one saturates, like the reference.
+    std::vector<double> input;
+    for (int n = 0; n < sampleCount; n++) {
+        input.push_back((n % 2 == 0) ? 0.999 : -1.0);
+    }
+    double peakSum = 0;
+    CHECK(biquadMaxError<PeakQ15, Q15>(input, pkB0, pkB1, pkB2, pkA1, pkA2, &peakSum) <= 1);
+    CHECK(peakSum >= 4.0);
+
+    // Small signals that never saturate still track the reference, though the high gain amplifies the rounding error
+    CHECK(biquadMaxError<PeakQ15, Q15>(noise(0.01), pkB0, pkB1, pkB2, pkA1, pkA2) <= 32);
+}
+
+static void testMedian() {
+    MedianFilter<5> filter;
+    std::vector<uint16_t> window(5, 0);
+    Random random;
+    for (int n = 0; n < sampleCount; n++) {
+        // Occasional spikes on a noisy level, with plenty of repeated values
+        uint16_t sample = (random.next() % 10 == 0) ? 4095 : uint16_t(random.range(1000, 1010));
+        window[n % 5] = sample;
+        std::vector<uint16_t> sorted = window;
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(filter.update(sample) == sorted[2]);
+    }
+}
+
+/// Order N CIC decimation is N cascaded boxcars of length Rate, then keeping every Rate'th output.
+template<uint8_t Order, uint16_t Rate>
+static void testCic() {
+    std::vector<int64_t> kernel(1, 1);
+    for (int stage = 0; stage < Order; stage++) {
+        std::vector<int64_t> next(kernel.size() + Rate - 1, 0);
+        for (size_t i = 0; i < kernel.size(); i++) {
+            for (int j = 0; j < Rate; j++) {
+                next[i + j] += kernel[i];
+            }
+        }
+        kernel = next;
+    }
+    const int64_t gain = int64_t(1) << CicDecimator<Order, Rate>::gainBits;
+
+    CicDecimator<Order, Rate> filter;
+    std::vector<uint16_t> input;
+    Random random;
+    int outputs = 0;
+    for (int n = 0; n < sampleCount; n++) {
+        uint16_t sample = uint16_t(random.range(0, 65535));
+        input.push_back(sample);
+        bool ready = filter.update(sample);
+        CHECK(ready == ((n + 1) % Rate == 0));
+        if (!ready) {
+            continue;
+        }
+        int64_t sum = 0;
+        for (size_t k = 0; (k < kernel.size()) && (k <= size_t(n)); k++) {
+            sum += kernel[k] * input[n - k];
+        }
+        CHECK(filter.output() == uint16_t(sum / gain));
+        outputs++;
+    }
+    CHECK(outputs == sampleCount / Rate);
+}
+
+int main() {
+    testBoxcar();
+    testEma();
+    testBiquad();
+    testBiquadHeadroom();
+    testMedian();
+    testCic<1, 16>();
+    testCic<2, 8>();
+    testCic<4, 16>();
+    return checkResult("filters");
+}
@@ -0,0 +1,161 @@
+// Feeds ResetLog fake SYSRSTIV sequences, one simulated boot at a time, and checks the counters and the history kept across them.
+
+#include <stdint.h>
+#include <initializer_list>
+
+#include "check.hpp"
+#include "fake_sysctl.hpp"
+// Built in, so each boot can clear the RAM state the way the C startup code does, while resetStore keeps its contents like FRAM
+#include "reset_cause.cpp"
+
+/// Reset with SYSRSTIV reporting `ivs`, and capture the causes. Returns what capture() returns.
+static ResetCause boot(std::initializer_list<uint16_t> ivs) {
+    queueResets(ivs);
+    captured = false;
+    latestCause = ResetCause::None;
+    latestCauses = 0;
+    ResetCause cause = ResetLog::capture();
+    // Every cause is read, and the program FRAM is protected again afterwards
+    CHECK(fakeSysRstIv.empty());
+    CHECK((fakeSysCfg0 & PFWP) != 0);
+    return cause;
+}
+
+static void testCauses() {
+    ResetLog::clear();
+    CHECK(ResetLog::total() == 0);
+
+    // Several causes at once: the first one read is the cause, and each is counted
+    CHECK(boot({0x02, 0x16}) == ResetCause::Brownout);
+    CHECK(ResetLog::cause() == ResetCause::Brownout);
+    CHECK(ResetLog::causedBy(ResetCause::Brownout));
+    CHECK(ResetLog::causedBy(ResetCause::WatchdogTimeout));
+    CHECK(!ResetLog::causedBy(ResetCause::ResetPin));
+    CHECK(ResetLog::count(ResetCause::Brownout) == 1);
+    CHECK(ResetLog::count(ResetCause::WatchdogTimeout) == 1);
+    CHECK(ResetLog::count(ResetCause::ResetPin) == 0);
+    CHECK(ResetLog::total() == 1);
+
+    // Only the first capture() after a reset reads SYSRSTIV
+    queueResets({0x04});
+    CHECK(ResetLog::capture() == ResetCause::Brownout);
+    CHECK(fakeSysRstIv.size() == 1);
+    CHECK(ResetLog::count(ResetCause::ResetPin) == 0);
+    CHECK(ResetLog::total() == 1);
+
+    // Values past the last cause are skipped
+    CHECK(boot({0x30, 0x04}) == ResetCause::ResetPin);
+    CHECK(ResetLog::count(ResetCause::ResetPin) == 1);
+    CHECK(ResetLog::total() == 2);
+    CHECK(boot({0x30}) == ResetCause::None);
+    CHECK(boot({}) == ResetCause::None);
+    CHECK(!ResetLog::causedBy(ResetCause::ResetPin));
+    CHECK(ResetLog::total() == 2);
+    CHECK(ResetLog::historyLength() == 2);
+
+    // Counters stop at 65535
+    resetStore.counts[static_cast<uint8_t>(ResetCause::FllUnlock) >> 1] = 0xFFFE;
+    resetStore.total = 0xFFFE;
+    boot({0x24});
+    boot({0x24});
+    CHECK(ResetLog::count(ResetCause::FllUnlock) == 0xFFFF);
+    CHECK(ResetLog::total() == 0xFFFF);
+
+    ResetLog::clear();
+    ResetRecord record;
+    CHECK(ResetLog::total() == 0);
+    CHECK(ResetLog::count(ResetCause::Brownout) == 0);
+    CHECK(ResetLog::historyLength() == 0);
+    CHECK(!ResetLog::history(0, record));
+}
+
+static void testHistory() {
+    ResetLog::clear();
+    ResetRecord record;
+    boot({0x02});
+    boot({0x04});
+    boot({0x16, 0x1C});
+    CHECK(ResetLog::historyLength() == 3);
+    CHECK(ResetLog::history(0, record));
+    CHECK(record.cause == ResetCause::WatchdogTimeout);
+    CHECK(record.causedBy(ResetCause::FramBitError));
+    CHECK(!record.causedBy(ResetCause::ResetPin));
+    CHECK(ResetLog::history(1, record));
+    CHECK(record.cause == ResetCause::ResetPin);
+    CHECK(ResetLog::history(2, record));
+    CHECK(record.cause == ResetCause::Brownout);
+    CHECK(!ResetLog::history(3, record));
+
+    // Past HAL_RESET_HISTORY resets, the oldest are dropped. The uptime tells the resets apart.
+    const uint8_t resets = HAL_RESET_HISTORY + 5;
+    ResetLog::clear();
+    for (uint8_t i = 0; i < resets; i++) {
+        ResetLog::setUptime(100 + i);
+        boot({0x04});
+    }
+    CHECK(ResetLog::total() == resets);
+    CHECK(ResetLog::count(ResetCause::ResetPin) == resets);
+    CHECK(ResetLog::historyLength() == HAL_RESET_HISTORY);
+    for (uint8_t age = 0; age < HAL_RESET_HISTORY; age++) {
+        CHECK(ResetLog::history(age, record));
+        CHECK(record.uptime == uint32_t(100 + resets - 1 - age));
+    }
+    CHECK(!ResetLog::history(HAL_RESET_HISTORY, record));
+}
+
+static void testUptime() {
+    ResetLog::clear();
+    ResetRecord record;
+
+    // The uptime is recorded with the next reset, then starts again from 0
+    ResetLog::setUptime(500);
+    ResetLog::setUptime(600);
+    CHECK((fakeSysCfg0 & PFWP) != 0);
+    boot({0x16});
+    CHECK(ResetLog::history(0, record));
+    CHECK(record.uptime == 600);
+    boot({0x16});
+    CHECK(ResetLog::history(0, record));
+    CHECK(record.uptime == 0);
+    CHECK(ResetLog::history(1, record));
+    CHECK(record.uptime == 600);
+}
+
+static void testLpm5Wakeup() {
+    ResetLog::clear();
+    ResetRecord record;
+    boot({0x04});
+
+    // A wakeup on its own is counted, but stays out of the total and the history, and the uptime carries on
+    ResetLog::setUptime(42);
+    CHECK(boot({0x08}) == ResetCause::Lpm5Wakeup);
+    CHECK(ResetLog::causedBy(ResetCause::Lpm5Wakeup));
+    CHECK(ResetLog::count(ResetCause::Lpm5Wakeup) == 1);
+    CHECK(ResetLog::total() == 1);
+    CHECK(ResetLog::historyLength() == 1);
+    CHECK(ResetLog::history(0, record));
+    CHECK(record.cause == ResetCause::ResetPin);
+    boot({0x16});
+    CHECK(ResetLog::total() == 2);
+    CHECK(ResetLog::history(0, record));
+    CHECK(record.uptime == 42);
+
+    // A wakeup with another cause is logged
+    ResetLog::setUptime(7);
+    CHECK(boot({0x04, 0x08}) == ResetCause::ResetPin);
+    CHECK(ResetLog::count(ResetCause::Lpm5Wakeup) == 2);
+    CHECK(ResetLog::total() == 3);
+    CHECK(ResetLog::historyLength() == 3);
+    CHECK(ResetLog::history(0, record));
+    CHECK(record.causedBy(ResetCause::Lpm5Wakeup));
+    CHECK(record.causedBy(ResetCause::ResetPin));
+    CHECK(record.uptime == 7);
+}
+
+int main() {
+    testCauses();
+    testHistory();
+    testUptime();
+    testLpm5Wakeup();
+    return checkResult("reset_cause");
+}
@@ -0,0 +1,228 @@
+// Drives TimerWheel from a fake Timebase, checking which callbacks run at each poll() and where the alarm is set.
+
+#include <stdint.h>
+#include <vector>
+
+#include "check.hpp"
+#include "fake_timebase.hpp"
+#include "timer_wheel.hpp"
+
+// 16 slots of 8 ticks, so the wheel turns every 128 ticks
+using Wheel = TimerWheel<4, 3>;
+// 64 slots, so the occupied bitmap spans four words
+using WideWheel = TimerWheel<6, 3>;
+
+/// A callback that ran, and the tick it ran at.
+struct Expiry {
+    SoftTimer* timer;
+    uint32_t tick;
+};
+static std::vector<Expiry> expiries;
+
+static void record(SoftTimer& timer) {
+    expiries.push_back({&timer, Timebase::now()});
+}
+
+static int runCount(const SoftTimer& timer) {
+    int count = 0;
+    for (const Expiry& expiry : expiries) {
+        count += (expiry.timer == &timer) ? 1 : 0;
+    }
+    return count;
+}
+
+static void begin(uint32_t tick = 0) {
+    Timebase::reset(tick);
+    expiries.clear();
+}
+
+/// Let time run from alarm to alarm, polling at each, until `tick`. Returns the number of alarms that fired.
+template<typename W>
+static int runUntil(uint32_t tick) {
+    int alarms = 0;
+    while (Timebase::alarmArmed() && (int32_t(Timebase::alarmTick() - tick) <= 0)) {
+        Timebase::advanceTo(Timebase::alarmTick());
+        W::poll();
+        alarms++;
+    }
+    Timebase::advanceTo(tick);
+    return alarms;
+}
+
+SoftTimer periodic = {&record};
+
+static void testPeriodicRelink() {
+    begin();
+    Wheel::schedule(periodic, 50, 100);
+    CHECK(Timebase::alarmTick() == 50);
+    Timebase::advanceTo(50);
+    Wheel::poll();
+    CHECK(runCount(periodic) == 1);
+    CHECK(Wheel::isScheduled(periodic));
+    CHECK(periodic.expiry == 150);
+    CHECK(Timebase::alarmTick() == 150);
+
+    // The next expiry is more than a turn after the first, and still lands exactly
+    runUntil<Wheel>(1000);
+    CHECK(runCount(periodic) == 10);
+    for (const Expiry& expiry : expiries) {
+        CHECK((expiry.tick % 100) == 50);
+    }
+    Wheel::cancel(periodic);
+    CHECK(Wheel::scheduledCount() == 0);
+
+    // A period shorter than a slot relinks into the slot being walked. Polled three periods late, it runs once and skips the expiries it missed.
+    begin(2000);
+    Wheel::schedule(periodic, 3, 3);
+    Timebase::advanceTo(2010);
+    Wheel::poll();
+    CHECK(runCount(periodic) == 1);
+    CHECK(periodic.expiry == 2012);
+    CHECK(Timebase::alarmTick() == 2012);
+    Wheel::cancel(periodic);
+}
+
+SoftTimer first = {&record};
+SoftTimer second = {&record};
+SoftTimer third = {&record};
+
+static void cancelSecond(SoftTimer& timer) {
+    record(timer);
+    Wheel::cancel(second);
+}
+
+static void cancelSelfAndSecond(SoftTimer& timer) {
+    record(timer);
+    Wheel::cancel(timer);
+    Wheel::cancel(second);
+}
+
+static void testCancelNeighbour() {
+    // Timers go to the head of their slot, so scheduling third, second, first walks first, second, third
+    begin();
+    first.callback = &cancelSecond;
+    Wheel::schedule(third, 20);
+    Wheel::schedule(second, 20);
+    Wheel::schedule(first, 20);
+    Timebase::advanceTo(20);
+    Wheel::poll();
+    CHECK(runCount(first) == 1);
+    CHECK(runCount(second) == 0);
+    CHECK(runCount(third) == 1);
+    CHECK(Wheel::scheduledCount() == 0);
+
+    // The same for a periodic timer that cancels itself as well: the walk must carry on from its old neighbour, not its relinked one
+    begin();
+    first.callback = &cancelSelfAndSecond;
+    Wheel::schedule(third, 20);
+    Wheel::schedule(second, 20);
+    Wheel::schedule(first, 20, 1);
+    Timebase::advanceTo(20);
+    Wheel::poll();
+    CHECK(runCount(first) == 1);
+    CHECK(runCount(second) == 0);
+    CHECK(runCount(third) == 1);
+    CHECK(Wheel::scheduledCount() == 0);
+    CHECK(!Timebase::alarmArmed());
+    first.callback = &record;
+}
+
+SoftTimer far = {&record};
+
+static void testBitmapWords() {
+    // From slot 5 (word 0) to slot 40 (word 2), skipping the empty word 1
+    begin(5 * 8);
+    WideWheel::schedule(far, 35 * 8 + 3);
+    CHECK(Timebase::alarmTick() == 40 * 8 + 3);
+    CHECK(runUntil<WideWheel>(40 * 8 + 3) == 1);
+    CHECK(runCount(far) == 1);
+
+    // From slot 60 (word 3) round to slot 3 (word 0) of the next turn
+    begin(60 * 8);
+    WideWheel::schedule(far, 7 * 8);
+    CHECK(Timebase::alarmTick() == (64 + 3) * 8);
+    CHECK(runUntil<WideWheel>((64 + 3) * 8) == 1);
+    CHECK(runCount(far) == 1);
+
+    // Slot 15 is the last bit of word 0, and slot 16 the first of word 1
+    for (uint16_t slot = 15; slot <= 16; slot++) {
+        begin();
+        WideWheel::schedule(far, slot * 8);
+        CHECK(Timebase::alarmTick() == slot * 8u);
+        CHECK(runUntil<WideWheel>(slot * 8) == 1);
+        CHECK(runCount(far) == 1);
+    }
+    CHECK(WideWheel::scheduledCount() == 0);
+}
+
+SoftTimer late[3] = {{&record}, {&record}, {&record}};
+
+static void testLatePoll() {
+    // Poll several turns late: every timer runs once, including the periodic one, which skips to its next expiry after now
+    begin();
+    Wheel::schedule(late[0], 10);
+    Wheel::schedule(late[1], 100);
+    Wheel::schedule(late[2], 200);
+    Wheel::schedule(periodic, 64, 64);
+    Timebase::advanceTo(1000);
+    Wheel::poll();
+    CHECK(runCount(late[0]) == 1);
+    CHECK(runCount(late[1]) == 1);
+    CHECK(runCount(late[2]) == 1);
+    CHECK(runCount(periodic) == 1);
+    CHECK(periodic.expiry == 1024);
+    CHECK(Timebase::alarmTick() == 1024);
+
+    // The cursor has caught up, so a new timer is found straight away
+    Wheel::schedule(late[0], 5);
+    CHECK(Timebase::alarmTick() == 1005);
+    runUntil<Wheel>(1005);
+    CHECK(runCount(late[0]) == 2);
+    Wheel::cancel(periodic);
+    CHECK(Wheel::scheduledCount() == 0);
+}
+
+static void testLaterTurn() {
+    // 300 ticks away is on the third turn. schedule() sets the alarm for it directly, but once poll() picks the alarm, it stops at the end
+    // of the timer's slot on each turn, without running it early.
+    begin();
+    Wheel::schedule(far, 300);
+    CHECK(Timebase::alarmTick() == 300);
+    Wheel::schedule(first, 20);
+    CHECK(Timebase::alarmTick() == 20);
+    Timebase::advanceTo(20);
+    Wheel::poll();
+    CHECK(runCount(first) == 1);
+    CHECK(Timebase::alarmTick() == 48);
+    Timebase::advanceTo(48);
+    Wheel::poll();
+    CHECK(runCount(far) == 0);
+    CHECK(Timebase::alarmTick() == 176);
+    Timebase::advanceTo(176);
+    Wheel::poll();
+    CHECK(runCount(far) == 0);
+    CHECK(Timebase::alarmTick() == 300);
+    runUntil<Wheel>(300);
+    CHECK(runCount(far) == 1);
+    CHECK(expiries.back().tick == 300);
+
+    // A nearer timer sharing the far timer's slot sets the alarm for itself
+    begin();
+    Wheel::schedule(far, 300);
+    Wheel::schedule(first, 44);
+    CHECK(Timebase::alarmTick() == 44);
+    runUntil<Wheel>(400);
+    CHECK(runCount(first) == 1);
+    CHECK(runCount(far) == 1);
+    CHECK(!Timebase::alarmArmed());
+    CHECK(Wheel::scheduledCount() == 0);
+}
+
+int main() {
+    testPeriodicRelink();
+    testCancelNeighbour();
+    testBitmapWords();
+    testLatePoll();
+    testLaterTurn();
+    return checkResult("timer_wheel");
+}
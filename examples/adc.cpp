@@ -2,6 +2,7 @@
 
 #include "hal/gpio.hpp"
 #include "hal/adc.hpp"
+#include "hal/adc_calibration.hpp"
 #include "hal/pmm.hpp"
 #include "hal/watchdog.hpp"
 
@@ -31,15 +32,16 @@ void main() {
     Vref vref = Vref::enable(VrefValue::_1V5);
     TempSensor tsense = TempSensor::enable(vref);
 
+    // The temperature sensor's factory calibration was measured against the 1.5V reference, so use it as the ADC reference too.
+    adc.init(AdcClockSource::ModClk, AdcPredivider::_4, AdcClockDivider::_1, AdcSampleTime::_1024, AdcPosRef::Vref);
+    // Read this chip's calibration values once. Each conversion is then just a multiply and a shift.
+    AdcCalibration<AdcResolution::_12Bit> cal = AdcCalibration<AdcResolution::_12Bit>::forVref(VrefValue::_1V5);
+
     while (1) {
         uint16_t count = adc.blockingConversion(tsense);
-        uint16_t temprMillivolts = adc.countToMillivolts(count, 3300); // Convert to voltage, assuming ADC vref = 3.3V.
-        // Equation 11 gives us this equation for calculating temperature from the temp sensor voltage:
-        // T = 0.00355 × (V_t – V_30C) + 30C, and V_30C = 788 mV (Table 5-10).
-        // Note integer division, so multiply first (beware overflow!), divide last to maximise accuracy
-        int16_t tempCelcius = ((355 * ((int32_t)(temprMillivolts) - 788)) + 30000) / 1000;
+        int16_t tempCentiCelsius = cal.toCentiCelsius(count);
 
-        if (tempCelcius >= 20 && tempCelcius <= 25) {
+        if (tempCentiCelsius >= 2000 && tempCentiCelsius <= 2500) {
             led2.setHigh();
         } else {
             led2.setLow();
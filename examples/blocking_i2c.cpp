@@ -2,6 +2,7 @@
 
 #include "hal/gpio.hpp"
 #include "hal/blocking_i2c.hpp"
+#include "hal/clock.hpp"
 #include "hal/watchdog.hpp"
 // Acts as an I2C master, sends various messages to 0x3F. See below for details.
 
@@ -22,8 +23,10 @@ void main() {
     gpioUnlock();
 
     // You must initialise I2C before using it!
-    // Note: This method has a default arguments for the stregnth of the glitch filter. You probably don't need to change it.
-    i2c.init(I2cClockSource::Smclk, 10); // Smclk ~= 1MHz, so /10 gives ~100kHz
+    // Note: This method has default arguments for the stregnth of the glitch filter, 7- or 10-bit addressing, and single or multi-master mode.
+    // You probably don't need to change them.
+    // The prescaler is calculated at compile time from the SMCLK frequency, to give a bus speed of at most 100kHz.
+    i2c.init(I2cClockSource::Smclk, eusciPrescaler(DefaultClockConfig::smclkHz, 100000));
 
     // Example I2C slave address
     uint8_t slaveAddress = 0x3F;
@@ -49,9 +52,9 @@ void main() {
 
     // transaction() allows for arbitrary combinations of operations.
     I2cOperation ops[3] = {
-        {I2cDirection::Transmit, bytes, 4}, 
-        {I2cDirection::Receive,  recv,  3}, 
-        {I2cDirection::Transmit, send,  1}, 
+        I2cOperation::transmit(bytes, 4),
+        I2cOperation::receive(recv, 3),
+        I2cOperation::transmit(send, 1),
     };
     // | S | 0x3F+W | A | 1 | A | 2 | A | 3 | A | 4 | A 
     // | R | 0x3F+R | A | ->recv[0] | A | ->recv[1] | A | ->recv[2] | N 
@@ -1,5 +1,5 @@
-#ifndef CLOCK_HPP
-#define CLOCK_HPP
+#ifndef ADC_HPP
+#define ADC_HPP
 
 #include <msp430.h>
 #include "pmm.hpp"
@@ -92,6 +92,50 @@ enum class AdcPowerMode {
     LowPower  = ADCSR,
 };
 
+/// Which channels are converted, and how many times
+enum class AdcSequence {
+    /// Convert one channel once.
+    SingleChannel = ADCCONSEQ_0,
+    /// Convert every channel from the selected channel down to A0, once.
+    Sequence = ADCCONSEQ_1,
+    /// Convert one channel repeatedly.
+    RepeatSingleChannel = ADCCONSEQ_2,
+    /// Convert every channel from the selected channel down to A0, repeatedly.
+    RepeatSequence = ADCCONSEQ_3,
+};
+
+/// What starts each ADC conversion
+enum class AdcTrigger {
+    /// Software, i.e. startConversion().
+    Software = ADCSHS_0,
+    /// Rising edge of the Timer_B1 CCR1 output (TB1.1B).
+    TimerB1 = ADCSHS_1,
+    /// Rising edge of the Timer_B2 CCR1 output (TB2.1B).
+    TimerB2 = ADCSHS_2,
+    /// Rising edge of the Timer_B3 CCR1 output (TB3.1B).
+    TimerB3 = ADCSHS_3,
+};
+
+/// Which window comparator condition to wait for. See Adc::startWindowMonitor().
+enum class AdcWindowWake {
+    /// Wait for a result above the window or below the window
+    Outside = ADCHIIE | ADCLOIE,
+    /// Wait for a result inside the window
+    Inside = ADCINIE,
+};
+
+/// A window comparator event
+enum class AdcWindowEvent {
+    /// No window comparator event was pending
+    None,
+    /// A result was above the top of the window
+    Above,
+    /// A result was below the bottom of the window
+    Below,
+    /// A result was inside the window
+    Inside,
+};
+
 // The following two enums collectively set ADCSREF, so the macro values don't quite line up how you might initially expect,
 // but they should work. AdcPosRef sets the bottom two bits, AdcNegRef sets the top bit.
 
@@ -117,6 +161,22 @@ enum class AdcNegRef {
 
 // Internal implementation details
 namespace detail {
+    constexpr uint8_t adcResolutionBits(AdcResolution resolution) {
+        return (resolution == AdcResolution::_8Bit)  ?  8 :
+               (resolution == AdcResolution::_10Bit) ? 10 : 12;
+    }
+
+    /// Number of ADCCLK cycles in one conversion: the sample time, then one cycle per result bit plus two.
+    constexpr uint16_t adcConversionCycles(AdcSampleTime time, AdcResolution resolution) {
+        return (adcResolutionBits(resolution) + 2) +
+               ((time == AdcSampleTime::_4)   ?    4 : (time == AdcSampleTime::_8)   ?    8 :
+                (time == AdcSampleTime::_16)  ?   16 : (time == AdcSampleTime::_32)  ?   32 :
+                (time == AdcSampleTime::_64)  ?   64 : (time == AdcSampleTime::_96)  ?   96 :
+                (time == AdcSampleTime::_128) ?  128 : (time == AdcSampleTime::_192) ?  192 :
+                (time == AdcSampleTime::_256) ?  256 : (time == AdcSampleTime::_384) ?  384 :
+                (time == AdcSampleTime::_512) ?  512 : (time == AdcSampleTime::_768) ?  768 : 1024);
+    }
+
     struct Vss {
         static constexpr int8_t adcChannel = 14;
     };
@@ -146,10 +206,10 @@ namespace detail {
     struct IsAdcChannel<Pin<PIN_PARAMS>> : std::true_type {};
 
     // ...or are one of the non-GPIO channels
-    struct IsAdcChannel<const Vss>  : std::true_type {};
-    struct IsAdcChannel<const Vcc>  : std::true_type {};
-    struct IsAdcChannel<Vref> : std::true_type {};
-    struct IsAdcChannel<TempSensor> : std::true_type {};
+    template<> struct IsAdcChannel<const Vss>  : std::true_type {};
+    template<> struct IsAdcChannel<const Vcc>  : std::true_type {};
+    template<> struct IsAdcChannel<Vref> : std::true_type {};
+    template<> struct IsAdcChannel<TempSensor> : std::true_type {};
 }
 
 namespace AdcChannel {
@@ -161,15 +221,18 @@ namespace AdcChannel {
 }
 
 struct Adc {
-    private:
     /// Determines if a template parameter T is a valid ADC channel or not.
     template<typename T>
     static constexpr bool isAdcChannelType() {
         return detail::IsAdcChannel<T>::value;
     }
+
+    /// Select a channel by number. ADCENC must be clear, e.g. after disable(). Prefer selectChannel(), which checks the channel at compile time.
     static void setChannel(uint8_t channel) {
         ADCMCTL0 = (ADCMCTL0 & ~ADCINCH) | (channel & ADCINCH);
     }
+
+    private:
     static void start() {
         ADCCTL0 |= ADCENC | ADCSC;
     }
@@ -211,6 +274,32 @@ struct Adc {
         ADCMCTL0 = posRef | negRef;
     }
 
+    /// Choose which channels are converted, and what triggers each conversion. init() sets up single, software-triggered conversions.
+    /// With a software trigger, sequences and repeated conversions run back-to-back as soon as the first is started.
+    /// With a timer trigger each rising edge of the timer output starts one conversion, so the timer sets the sample rate.
+    /// The timer must be configured separately: e.g. TB1 in up mode with TB1CCR0 = period-1, TB1CCR1 = period/2 and TB1CCTL1 = OUTMOD_7.
+    static void configureConversions(AdcSequence sequence, AdcTrigger trigger) {
+        uint16_t conseq = static_cast<uint16_t>(sequence);
+        uint16_t shs    = static_cast<uint16_t>(trigger);
+
+        // Clear ADCENC prior to configuration
+        ADCCTL0 &= ~ADCENC;
+        ADCCTL1 = (ADCCTL1 & ~(ADCSHS | ADCCONSEQ)) | shs | conseq;
+        if ((trigger == AdcTrigger::Software) && (sequence != AdcSequence::SingleChannel)) {
+            ADCCTL0 |= ADCMSC;
+        } else {
+            ADCCTL0 &= ~ADCMSC;
+        }
+    }
+
+    /// Select the channel to convert (or the first channel of a sequence). ADCENC must be clear, e.g. after disable().
+    template<typename Pin>
+    static void selectChannel(Pin& adcPin) {
+        static_assert(isAdcChannelType<Pin>(), "The type of adcPin must be one of 'Pin<...>', 'Vref', 'TempSensor', 'Vcc', or 'Vss'.");
+        static_assert(adcPin.adcChannel >= 0, "Attempted to read from pin not connected to ADC");
+        setChannel(adcPin.adcChannel);
+    }
+
     /// Begin an ADC conversion and wait for it to finish, returning the result.
     template<typename Pin>
     static uint16_t blockingConversion(Pin& adcPin) {
@@ -220,16 +309,33 @@ struct Adc {
     }
 
     /// Begin an ADC conversion and immediately return without waiting for it to complete.
+    /// The ADC is left powered between conversions. ADCENC is only cleared if the channel has to change, so repeated conversions of the same channel start immediately.
     template<typename Pin>
     static void startConversion(Pin& adcPin) {
         static_assert(isAdcChannelType<Pin>(), "The type of adcPin must be one of 'Pin<...>', 'Vref', 'TempSensor', 'Vcc', or 'Vss'.");
         static_assert(adcPin.adcChannel >= 0, "Attempted to read from pin not connected to ADC");
-        disable();
-        setChannel(adcPin.adcChannel);
+        if ((ADCMCTL0 & ADCINCH) != adcPin.adcChannel) {
+            // The channel can only be changed while ADCENC is clear
+            ADCCTL0 &= ~ADCENC;
+            setChannel(adcPin.adcChannel);
+        }
         enable();
         start();
     }
 
+    /// Convert the same channel as the previous startConversion() again. This is a single register write, for tight sampling loops.
+    /// The previous conversion must have finished, and the ADC must not have been disabled since.
+    static void retrigger() {
+        start();
+    }
+
+    /// Convert the same channel as the previous conversion again and wait for it to finish, returning the result. See retrigger().
+    static uint16_t blockingRetrigger() {
+        retrigger();
+        while(isBusy());
+        return getConversionResult();
+    }
+
     /// Returns true while the ADC is still converting. Returns false when the ADC result is ready to read. The inverse of adcResultReady().
     static bool isBusy() {
         return ADCCTL1 & ADCBUSY;
@@ -245,20 +351,15 @@ struct Adc {
         return ADCMEM0;
     }
 
-    /// Convert a count into millivolts, given a reference voltage.
-    /// Assumes that the resolution of the ADC has not changed since the count was measured.
+    /// Convert a count into millivolts, given a reference voltage. `Resolution` must match the resolution the ADC was initialised with.
+    /// This uses the nominal reference voltage. For this chip's calibration values, see AdcCalibration.
+    template<AdcResolution Resolution = AdcResolution::_12Bit>
     static uint16_t countToMillivolts(uint16_t count, uint16_t refVoltageMillivolts) {
-        uint8_t resolutionBits;
-        switch (ADCCTL2 & ADCRES) {
-            case ADCRES_0: resolutionBits =  8; break;
-            case ADCRES_1: resolutionBits = 10; break;
-            default:       resolutionBits = 12; break;
-        }
-        return uint16_t((uint32_t(count) * uint32_t(refVoltageMillivolts)) >> resolutionBits);
+        return uint16_t((uint32_t(count) * uint32_t(refVoltageMillivolts)) >> detail::adcResolutionBits(Resolution));
     }
 
     /// Enable the ADC, ready to begin conversions.
-    /// This is called automatically when a conversion is begun.
+    /// This is called automatically when a conversion is begun. The ADC then stays powered until disable() is called.
     static void enable() {
         ADCCTL0 |= ADCON;
     }
@@ -267,6 +368,83 @@ struct Adc {
     static void disable() {
         ADCCTL0 &= ~(ADCON | ADCENC);
     }
+
+    /// Repeatedly convert `adcPin` and compare each result against a window, without any CPU involvement. 
+    /// The ADC interrupt only fires when the result crosses into or out of the window, so the CPU can stay in a low power mode in the meantime.
+    /// `low` and `high` are counts in the configured ADC resolution. `wake` is the first condition to wait for. 
+    /// After each event handleWindowInterrupt() automatically waits for the opposite condition, so every crossing generates exactly one interrupt.
+    /// With a software trigger conversions run back-to-back. A timer trigger (see configureConversions()) reduces the ADC's power usage.
+    template<typename Pin>
+    static void startWindowMonitor(Pin& adcPin, uint16_t low, uint16_t high, AdcWindowWake wake, AdcTrigger trigger = AdcTrigger::Software) {
+        disable();
+        selectChannel(adcPin);
+        configureConversions(AdcSequence::RepeatSingleChannel, trigger);
+        ADCLO = low;
+        ADCHI = high;
+        ADCIFG &= ~(ADCHIIFG | ADCLOIFG | ADCINIFG);
+        ADCIE = (ADCIE & ~(ADCHIIE | ADCLOIE | ADCINIE)) | static_cast<uint16_t>(wake);
+        arm(trigger);
+    }
+
+    /// Stop the window monitor and return the ADC to single, software-triggered conversions.
+    static void stopWindowMonitor() {
+        ADCIE &= ~(ADCHIIE | ADCLOIE | ADCINIE);
+        disable();
+        configureConversions(AdcSequence::SingleChannel, AdcTrigger::Software);
+    }
+
+    /// Start converting with the conversion-complete interrupt (ADCIFG0) enabled, so each result can be read from the ADC interrupt.
+    /// Select the channel (or the first channel of the sequence) first, with ADCENC clear, e.g. after disable().
+    /// This is how AdcOversampler, AdcScan and AdcStream start.
+    static void startSequence(AdcSequence sequence, AdcTrigger trigger) {
+        configureConversions(sequence, trigger);
+        ADCIFG &= ~ADCIFG0;
+        ADCIE |= ADCIE0;
+        arm(trigger);
+    }
+
+    /// Stop the conversions begun by startSequence(), and return the ADC to single, software-triggered conversions.
+    static void stopSequence() {
+        ADCIE &= ~ADCIE0;
+        disable();
+        configureConversions(AdcSequence::SingleChannel, AdcTrigger::Software);
+    }
+
+    /// Call this from the ADC interrupt while the window monitor is running. Returns which event occurred, and 
+    /// starts waiting for the opposite condition (e.g. after leaving the window, waits for the result to return inside it).
+    static AdcWindowEvent handleWindowInterrupt() {
+        switch (__even_in_range(ADCIV, ADCIV__ADCIFG0)) {
+            case ADCIV__ADCHIIFG:
+                waitFor(AdcWindowWake::Inside);
+                return AdcWindowEvent::Above;
+            case ADCIV__ADCLOIFG:
+                waitFor(AdcWindowWake::Inside);
+                return AdcWindowEvent::Below;
+            case ADCIV__ADCINIFG:
+                waitFor(AdcWindowWake::Outside);
+                return AdcWindowEvent::Inside;
+            default:
+                return AdcWindowEvent::None;
+        }
+    }
+
+    private:
+    /// Power the ADC and enable conversions. A software trigger starts the first conversion now, a timer trigger at its next edge.
+    static void arm(AdcTrigger trigger) {
+        enable();
+        if (trigger == AdcTrigger::Software) {
+            ADCCTL0 |= ADCENC | ADCSC;
+        } else {
+            ADCCTL0 |= ADCENC;
+        }
+    }
+
+    /// Switch the window comparator interrupts to a new condition. Flags set while waiting for the old condition are discarded.
+    static void waitFor(AdcWindowWake wake) {
+        ADCIE &= ~(ADCHIIE | ADCLOIE | ADCINIE);
+        ADCIFG &= ~(ADCHIIFG | ADCLOIFG | ADCINIFG);
+        ADCIE |= static_cast<uint16_t>(wake);
+    }
 };
 
 #endif
@@ -0,0 +1,112 @@
+#ifndef ADC_CALIBRATION_HPP
+#define ADC_CALIBRATION_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "adc.hpp"
+#include "pmm.hpp"
+
+// Internal implementation details
+namespace detail {
+    // Addresses of the factory calibration values in the device descriptor (TLV) area. See the 'Device Descriptors' table of the datasheet.
+    // Every value was measured at 12-bit resolution.
+    namespace Tlv {
+        /// ADC gain factor, in units of 1/32768.
+        constexpr uint16_t adcGain      = 0x1A16;
+        /// ADC offset, in signed 12-bit counts.
+        constexpr uint16_t adcOffset    = 0x1A18;
+        /// Temperature sensor reading at 30C, using the 1.5V reference.
+        constexpr uint16_t temp30C      = 0x1A1A;
+        /// Temperature sensor reading at 105C, using the 1.5V reference.
+        constexpr uint16_t temp105C     = 0x1A1C;
+        /// Reference correction factors, in units of 1/32768.
+        constexpr uint16_t ref1V5Factor = 0x1A20;
+        constexpr uint16_t ref2VFactor  = 0x1A22;
+        constexpr uint16_t ref2V5Factor = 0x1A24;
+    }
+
+    inline uint16_t readTlv(uint16_t address) {
+        return *reinterpret_cast<const volatile uint16_t*>(address);
+    }
+}
+
+/// Converts ADC counts to millivolts and degrees using this chip's factory calibration, rather than datasheet typical values.
+/// The calibration values are read once (by forVref() or forVcc()) and turned into fixed-point coefficients, so each conversion afterwards
+/// is one 32-bit multiply (done by MPY32) and a shift. `Resolution` must match the resolution the ADC was initialised with.
+///
+/// ```
+/// Vref vref = Vref::enable(VrefValue::_1V5);
+/// TempSensor tsense = TempSensor::enable(vref);
+/// auto cal = AdcCalibration<AdcResolution::_12Bit>::forVref(VrefValue::_1V5);
+/// int16_t centiCelsius = cal.toCentiCelsius(adc.blockingConversion(tsense));
+/// ```
+template<AdcResolution Resolution>
+struct AdcCalibration {
+    private:
+    static constexpr uint8_t bits = detail::adcResolutionBits(Resolution);
+    /// The calibration data is in 12-bit counts. Conversions at lower resolutions are scaled up by this much.
+    static constexpr uint8_t scaleShift = 12 - bits;
+    /// Fractional bits of the millivolt coefficients
+    static constexpr uint8_t mvShift = 16;
+    /// Fractional bits of the temperature coefficient
+    static constexpr uint8_t tempShift = 12;
+
+    /// mV = (count * mvScale + mvOffset) >> mvShift
+    uint32_t mvScale;
+    int32_t mvOffset;
+    /// centi-C = (((count << scaleShift) - temp30Count) * tempScale) >> tempShift + 3000
+    int32_t tempScale;
+    int16_t temp30Count;
+
+    static AdcCalibration calculate(uint16_t refMillivolts, uint16_t refFactor) {
+        AdcCalibration cal;
+
+        // Millivolts per 12-bit count with 16 fractional bits, corrected for gain and reference error.
+        // Applied one factor at a time so the intermediate values fit in 32 bits.
+        uint32_t nominal = uint32_t(refMillivolts) << (mvShift - 12);
+        uint32_t scale = (nominal * detail::readTlv(detail::Tlv::adcGain)) >> 15;
+        scale = (scale * refFactor) >> 15;
+        cal.mvScale = scale << scaleShift;
+        // The offset is added after the gain correction, so it is scaled by the nominal reference only
+        cal.mvOffset = int32_t(int16_t(detail::readTlv(detail::Tlv::adcOffset))) * int32_t(nominal);
+
+        // The temperature points are only meaningful with the 1.5V reference, see toCentiCelsius()
+        uint16_t temp30 = detail::readTlv(detail::Tlv::temp30C);
+        uint16_t temp105 = detail::readTlv(detail::Tlv::temp105C);
+        cal.temp30Count = temp30;
+        cal.tempScale = ((int32_t(105 - 30) * 100) << tempShift) / (int32_t(temp105) - int32_t(temp30));
+        return cal;
+    }
+
+    public:
+    /// Read the calibration for conversions using the internal reference (AdcPosRef::Vref) at `vref`.
+    static AdcCalibration forVref(VrefValue vref) {
+        switch (vref) {
+            case VrefValue::_1V5: return calculate(1500, detail::readTlv(detail::Tlv::ref1V5Factor));
+            case VrefValue::_2V:  return calculate(2000, detail::readTlv(detail::Tlv::ref2VFactor));
+            default:              return calculate(2500, detail::readTlv(detail::Tlv::ref2V5Factor));
+        }
+    }
+
+    /// Read the calibration for conversions using AVCC (AdcPosRef::Vcc) as the reference. Only the ADC's gain and offset are corrected,
+    /// so the result is only as accurate as `vccMillivolts`.
+    static AdcCalibration forVcc(uint16_t vccMillivolts) {
+        return calculate(vccMillivolts, 1u << 15);
+    }
+
+    /// Convert a count into millivolts.
+    uint16_t toMillivolts(uint16_t count) const {
+        int32_t mv = (int32_t(count) * int32_t(mvScale) + mvOffset) >> mvShift;
+        return (mv < 0) ? 0 : uint16_t(mv);
+    }
+
+    /// Convert a temperature sensor count into hundredths of a degree Celsius.
+    /// Only valid for a calibration from forVref(VrefValue::_1V5), with the ADC using the 1.5V reference, as that's how the factory calibration points were measured.
+    int16_t toCentiCelsius(uint16_t count) const {
+        int32_t delta = (int32_t(count) << scaleShift) - temp30Count;
+        return int16_t(((delta * tempScale) >> tempShift) + 3000);
+    }
+};
+
+#endif /* ADC_CALIBRATION_HPP */
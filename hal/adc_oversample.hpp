@@ -0,0 +1,142 @@
+#ifndef ADC_OVERSAMPLE_HPP
+#define ADC_OVERSAMPLE_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "adc.hpp"
+
+/// Increases the effective resolution of one ADC channel by oversampling and decimating.
+/// Each result is the sum of 4^ExtraBits conversions, shifted right by ExtraBits with rounding, which gives ExtraBits more bits than the ADC's
+/// resolution (e.g. `AdcOversampler<3>` turns 12-bit conversions into 15-bit results), at 1/4^ExtraBits of the sample rate.
+/// The extra bits are only real if the input has at least ~1 LSB of random noise on it. A perfectly quiet DC input gives the same conversion every time,
+/// and summing identical conversions doesn't add any information.
+///
+/// Conversions are accumulated in the ADC interrupt, so the main loop only sees finished results.
+/// The ADC must first be initialised with Adc::init(). handleInterrupt() must be called from the ADC interrupt:
+/// ```
+/// #pragma vector=ADC_VECTOR
+/// __interrupt void ADC_ISR(void) {
+///     if (oversampler.handleInterrupt()) {
+///         __bic_SR_register_on_exit(LPM0_bits); // A new result is ready, wake the CPU
+///     }
+/// }
+/// ```
+template<uint8_t ExtraBits>
+struct AdcOversampler {
+    static_assert(ExtraBits >= 1, "Oversampling needs at least one extra bit");
+    static_assert(ExtraBits <= 4, "Results are 16 bits, so at most 4 extra bits can be added to a 12-bit conversion");
+
+    /// Number of conversions summed into each result.
+    static constexpr uint16_t samplesPerResult = uint16_t(1) << (2 * ExtraBits);
+
+    /// Number of bits in each result, given the resolution the ADC was initialised with.
+    static constexpr uint8_t effectiveBits(AdcResolution resolution) {
+        return ExtraBits + detail::adcResolutionBits(resolution);
+    }
+
+    /// Number of results per second, given the number of conversions per second (e.g. the trigger timer's frequency).
+    static constexpr uint32_t outputRate(uint32_t sampleRateHz) {
+        return sampleRateHz >> (2 * ExtraBits);
+    }
+
+    private:
+    struct State {
+        uint32_t sum;
+        uint16_t remaining;
+        volatile uint16_t result;
+        volatile uint16_t sequence;
+        /// The trigger timer's CCR1 when dithering, otherwise nullptr.
+        volatile uint16_t* ditherCcr;
+        uint16_t ditherBase;
+        uint16_t ditherMask;
+        uint16_t lfsr;
+    };
+    static State s;
+
+    static volatile uint16_t* triggerCcr(AdcTrigger trigger) {
+        switch (trigger) {
+            case AdcTrigger::TimerB1: return &TB1CCR1;
+            case AdcTrigger::TimerB2: return &TB2CCR1;
+            case AdcTrigger::TimerB3: return &TB3CCR1;
+            default:                  return nullptr;
+        }
+    }
+
+    /// Move the next trigger edge by a pseudo-random number of timer counts.
+    static void dither() {
+        // 16-bit Galois LFSR, period 65535
+        s.lfsr = (s.lfsr >> 1) ^ ((s.lfsr & 1) ? 0xB400 : 0);
+        *s.ditherCcr = s.ditherBase + (s.lfsr & s.ditherMask);
+    }
+
+    public:
+    /// Begin oversampling `adcPin` every time `trigger` fires. Any partially accumulated result is discarded.
+    ///
+    /// If `ditherMask` is non-zero (and the trigger is a timer), the time of each conversion is moved by a pseudo-random 0 to ditherMask timer counts,
+    /// by rewriting the timer's CCR1 after every conversion. This spreads the sampling instants out so that periodic interference
+    /// (e.g. a switching regulator locked to the same clock) is averaged out rather than aliased into the result. It isn't a replacement
+    /// for analog noise on a quiet input. `ditherMask` must be one less than a power of two, the timer output must rise at CCR1 (e.g. OUTMOD_3, set/reset),
+    /// and CCR1 + ditherMask must stay below CCR0.
+    template<typename Pin>
+    static void start(Pin& adcPin, AdcTrigger trigger, uint16_t ditherMask = 0) {
+        Adc::disable();
+        s.sum = 0;
+        s.remaining = samplesPerResult;
+        s.sequence = 0;
+        s.ditherCcr = (ditherMask != 0) ? triggerCcr(trigger) : nullptr;
+        if (s.ditherCcr) {
+            s.ditherBase = *s.ditherCcr;
+            s.ditherMask = ditherMask;
+            s.lfsr = 0xACE1;
+        }
+
+        Adc::selectChannel(adcPin);
+        Adc::startSequence(AdcSequence::RepeatSingleChannel, trigger);
+    }
+
+    /// Stop oversampling and return the ADC to single, software-triggered conversions. If dithering was used the timer's CCR1 is restored.
+    static void stop() {
+        Adc::stopSequence();
+        if (s.ditherCcr) {
+            *s.ditherCcr = s.ditherBase;
+            s.ditherCcr = nullptr;
+        }
+    }
+
+    /// Call this from the ADC interrupt. Returns true when a new result has just been produced.
+    static bool handleInterrupt() {
+        s.sum += ADCMEM0; // Reading ADCMEM0 clears the interrupt flag
+        if (s.ditherCcr) {
+            dither();
+        }
+        if (--s.remaining != 0) {
+            return false;
+        }
+
+        // Decimate: add half an output LSB so the shift rounds to nearest instead of truncating
+        s.result = uint16_t((s.sum + (uint32_t(1) << (ExtraBits - 1))) >> ExtraBits);
+        s.sum = 0;
+        s.remaining = samplesPerResult;
+        // Sequence number 0 means 'no result yet', so skip it when wrapping around
+        if (++s.sequence == 0) {
+            s.sequence = 1;
+        }
+        return true;
+    }
+
+    /// Copy the most recent result into `result`. Returns false if no result has been produced yet.
+    static bool readLatest(uint16_t& result) {
+        uint16_t seq;
+        do {
+            seq = s.sequence;
+            result = s.result;
+        } while (seq != s.sequence);
+        return seq != 0;
+    }
+};
+
+template<uint8_t ExtraBits>
+typename AdcOversampler<ExtraBits>::State AdcOversampler<ExtraBits>::s;
+
+#endif /* ADC_OVERSAMPLE_HPP */
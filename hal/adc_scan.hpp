@@ -0,0 +1,193 @@
+#ifndef ADC_SCAN_HPP
+#define ADC_SCAN_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <initializer_list>
+
+#include "adc.hpp"
+
+// Internal implementation details
+namespace detail {
+    constexpr bool allTrue(std::initializer_list<bool> values) {
+        for (bool value : values) {
+            if (!value) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template<size_t N>
+    constexpr int8_t highestChannel(const int8_t (&channels)[N]) {
+        int8_t highest = -1;
+        for (size_t i = 0; i < N; i++) {
+            if (channels[i] > highest) {
+                highest = channels[i];
+            }
+        }
+        return highest;
+    }
+
+    template<size_t N>
+    constexpr int8_t lowestChannel(const int8_t (&channels)[N]) {
+        int8_t lowest = 15;
+        for (size_t i = 0; i < N; i++) {
+            if (channels[i] < lowest) {
+                lowest = channels[i];
+            }
+        }
+        return lowest;
+    }
+
+    template<size_t N>
+    constexpr bool hasDuplicateChannels(const int8_t (&channels)[N]) {
+        for (size_t i = 0; i < N; i++) {
+            for (size_t j = i + 1; j < N; j++) {
+                if (channels[i] == channels[j]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /// Maps an ADC channel number to the index of that channel's result, or -1 if the channel isn't part of the scan.
+    struct AdcScanSlots {
+        int8_t slot[16];
+    };
+
+    template<size_t N>
+    constexpr AdcScanSlots makeAdcScanSlots(const int8_t (&channels)[N]) {
+        AdcScanSlots slots = {};
+        for (uint8_t ch = 0; ch < 16; ch++) {
+            slots.slot[ch] = -1;
+        }
+        for (size_t i = 0; i < N; i++) {
+            slots.slot[channels[i]] = i;
+        }
+        return slots;
+    }
+}
+
+/// Converts several ADC channels in one hardware sequence, e.g. `AdcScan<Pin<P1,1>, Pin<P1,4>, TempSensor>`.
+/// Channel types are checked at compile time. Results are collected by the ADC interrupt and delivered together,
+/// so every result in a scan is taken within a few microseconds of the others.
+///
+/// The ADC's sequence modes always convert from the highest channel down to A0, so every channel in between is converted too
+/// (their results are discarded). Put the scanned channels on low-numbered pins to keep scans short.
+/// Each result must be read before the next conversion finishes, so the ADC sample time must be long enough for handleInterrupt() to run.
+///
+/// The ADC must first be initialised with Adc::init(). handleInterrupt() must be called from the ADC interrupt:
+/// ```
+/// #pragma vector=ADC_VECTOR
+/// __interrupt void ADC_ISR(void) {
+///     if (scan.handleInterrupt()) {
+///         __bic_SR_register_on_exit(LPM0_bits); // A scan has finished, wake the CPU
+///     }
+/// }
+/// ```
+template<typename... Channels>
+struct AdcScan {
+    /// Number of channels in the scan.
+    static constexpr uint8_t count = sizeof...(Channels);
+
+    static_assert(count > 0, "AdcScan needs at least one channel.");
+    static_assert(detail::allTrue({Adc::isAdcChannelType<Channels>()...}), "Every channel must be one of 'Pin<...>', 'Vref', 'TempSensor', 'Vcc', or 'Vss'.");
+
+    private:
+    static constexpr int8_t channels[count] = {Channels::adcChannel...};
+    static_assert(detail::lowestChannel(channels) >= 0, "Attempted to scan a pin not connected to ADC");
+    static_assert(!detail::hasDuplicateChannels(channels), "Each channel may only appear once in a scan");
+
+    /// The sequence starts from this channel and counts down to A0.
+    static constexpr int8_t firstChannel = detail::highestChannel(channels);
+    static constexpr detail::AdcScanSlots slots = detail::makeAdcScanSlots(channels);
+
+    public:
+    /// The results of a single scan, in the same order as the template parameters.
+    struct Results {
+        uint16_t value[count];
+
+        /// Get the result of the I'th channel in the template parameter list.
+        template<uint8_t I>
+        uint16_t get() const {
+            static_assert(I < count, "Index out of range of the scanned channels");
+            return value[I];
+        }
+    };
+
+    private:
+    struct State {
+        Results results[2];
+        /// The half of `results` holding the most recent complete scan.
+        volatile uint8_t front;
+        volatile uint16_t sequence;
+        /// The channel the next conversion result belongs to.
+        int8_t current;
+    };
+    static State s;
+
+    public:
+    /// Begin scanning. The channels are passed in (in the same order as the template parameters) to prove that
+    /// channels such as the temperature sensor have been enabled.
+    /// If `repeat` is false one scan is taken, otherwise scans run back-to-back until stop() is called.
+    /// With a timer trigger each rising edge of the timer converts one channel of the sequence.
+    static void start(bool repeat, AdcTrigger trigger, const Channels&... channelTokens) {
+        Adc::disable();
+        s.current = firstChannel;
+
+        Adc::setChannel(firstChannel);
+        Adc::startSequence(repeat ? AdcSequence::RepeatSequence : AdcSequence::Sequence, trigger);
+    }
+
+    /// Stop scanning and return the ADC to single, software-triggered conversions. A partially complete scan is discarded.
+    static void stop() {
+        Adc::stopSequence();
+    }
+
+    /// Call this from the ADC interrupt. Returns true when a scan has just completed.
+    static bool handleInterrupt() {
+        uint16_t result = ADCMEM0; // Reading ADCMEM0 clears the interrupt flag
+        int8_t slot = slots.slot[s.current];
+        if (slot >= 0) {
+            s.results[s.front ^ 1].value[slot] = result;
+        }
+        if (s.current > 0) {
+            s.current--;
+            return false;
+        }
+
+        // Channel A0 is always the end of the sequence
+        s.current = firstChannel;
+        s.front ^= 1;
+        // Sequence number 0 means 'no result yet', so skip it when wrapping around
+        if (++s.sequence == 0) {
+            s.sequence = 1;
+        }
+        return true;
+    }
+
+    /// Copy the results of the most recently completed scan into `results`.
+    /// Returns false if no scan has completed yet.
+    static bool readLatest(Results& results) {
+        uint16_t seq;
+        do {
+            seq = s.sequence;
+            results = s.results[s.front];
+        } while (seq != s.sequence);
+        return seq != 0;
+    }
+};
+
+template<typename... Channels>
+constexpr int8_t AdcScan<Channels...>::channels[];
+
+template<typename... Channels>
+constexpr detail::AdcScanSlots AdcScan<Channels...>::slots;
+
+template<typename... Channels>
+typename AdcScan<Channels...>::State AdcScan<Channels...>::s;
+
+#endif /* ADC_SCAN_HPP */
@@ -0,0 +1,98 @@
+#ifndef ADC_STREAM_HPP
+#define ADC_STREAM_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "adc.hpp"
+
+/// Continuously samples one ADC channel into a pair of ping-pong buffers, each `HalfLength` samples long.
+/// While the ADC fills one half the application processes the other. Conversions are started by a Timer_B output,
+/// so the sample rate is set by hardware and doesn't jitter with whatever the main loop is doing.
+///
+/// The ADC must first be initialised with Adc::init(), and the timer configured to produce the desired sample rate
+/// (see Adc::configureConversions()). handleInterrupt() must be called from the ADC interrupt:
+/// ```
+/// #pragma vector=ADC_VECTOR
+/// __interrupt void ADC_ISR(void) {
+///     if (stream.handleInterrupt()) {
+///         __bic_SR_register_on_exit(LPM0_bits); // A half is full, wake the CPU
+///     }
+/// }
+/// ```
+/// At high sample rates (up to the ADC's 200 ksps) MCLK must be fast enough to run the interrupt between samples.
+template<uint16_t HalfLength>
+struct AdcStream {
+    private:
+    struct State {
+        uint16_t buffer[2][HalfLength];
+        /// Index of the next sample in the half currently being filled.
+        uint16_t index;
+        /// The half currently being filled.
+        uint8_t filling;
+        /// The half that is full and waiting to be processed, or -1 if there isn't one.
+        volatile int8_t ready;
+        volatile uint16_t overruns;
+    };
+    static State s;
+
+    public:
+    /// Begin sampling `adcPin` every time `trigger` fires. Any previously collected samples are discarded.
+    template<typename Pin>
+    static void start(Pin& adcPin, AdcTrigger trigger) {
+        Adc::disable();
+        s.index = 0;
+        s.filling = 0;
+        s.ready = -1;
+        s.overruns = 0;
+
+        Adc::selectChannel(adcPin);
+        Adc::startSequence(AdcSequence::RepeatSingleChannel, trigger);
+    }
+
+    /// Stop sampling and return the ADC to single, software-triggered conversions.
+    static void stop() {
+        Adc::stopSequence();
+    }
+
+    /// Call this from the ADC interrupt. Returns true when a half has just been filled.
+    static bool handleInterrupt() {
+        s.buffer[s.filling][s.index] = ADCMEM0; // Reading ADCMEM0 clears the interrupt flag
+        if (++s.index < HalfLength) {
+            return false;
+        }
+        s.index = 0;
+        if (s.ready >= 0) {
+            // The application didn't take the previous half in time, so it is about to be overwritten
+            s.overruns++;
+        }
+        s.ready = s.filling;
+        s.filling ^= 1;
+        return true;
+    }
+
+    /// Returns the half of the buffer that was most recently filled, or nullptr if no new half is ready.
+    /// The returned samples are valid until the ADC fills the other half, i.e. for HalfLength sample periods.
+    static const uint16_t* takeReadyHalf() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        int8_t half = s.ready;
+        s.ready = -1;
+        __set_interrupt_state(interruptState);
+
+        if (half < 0) {
+            return nullptr;
+        }
+        return s.buffer[half];
+    }
+
+    /// Number of halves that were filled before the application took the previous one.
+    static uint16_t overruns() {
+        return s.overruns;
+    }
+};
+
+template<uint16_t HalfLength>
+typename AdcStream<HalfLength>::State AdcStream<HalfLength>::s;
+
+#endif /* ADC_STREAM_HPP */
@@ -5,6 +5,7 @@
 #include <msp430.h>
 
 #include "util.hpp"
+#include "eusci.hpp"
 
 enum class I2cClockSource {
     ExternalUClki = UCSSEL__UCLKI,
@@ -19,15 +20,41 @@ enum class DeglitchTime {
     _6_25ns = UCGLIT_3,
 };
 
+enum class I2cAddressing {
+    /// Slaves have 7-bit addresses
+    _7Bit  = UCSLA10__7BIT,
+    /// Slaves have 10-bit addresses
+    _10Bit = UCSLA10__10BIT,
+};
+
+enum class I2cBusMode {
+    /// This is the only master on the bus
+    SingleMaster = UCMM__SINGLE,
+    /// Other masters share the bus. Arbitration losses are detected and the transaction is retried.
+    MultiMaster  = UCMM__MULTI,
+};
+
 enum class I2cDirection {
     Transmit,
     Receive,
 };
 
+/// One operation within an I2C transaction. Build them with transmit() and receive(), which fill in the matching buffer.
 struct I2cOperation {
     I2cDirection dir;
-    uint8_t* data;
+    /// The bytes to send, for Transmit operations. Never written to, so it can point directly into a `const` table in FRAM.
+    const uint8_t* send;
+    /// Where the received bytes go, for Receive operations.
+    uint8_t* recv;
     uint16_t len;
+
+    static I2cOperation transmit(const uint8_t buf[], uint16_t len) {
+        return I2cOperation {I2cDirection::Transmit, buf, nullptr, len};
+    }
+
+    static I2cOperation receive(uint8_t buf[], uint16_t len) {
+        return I2cOperation {I2cDirection::Receive, nullptr, buf, len};
+    }
 };
 
 #define I2C_B0 &UCB0CTLW0, &UCB0CTLW1, &UCB0BRW, &UCB0STATW, &UCB0RXBUF, &UCB0TXBUF, &UCB0I2CSA, &UCB0IE, &UCB0IFG, &UCB0IV
@@ -47,16 +74,65 @@ template<
     volatile uint16_t* IV
 >
 struct I2cMaster {
+    public:
+    /// Returned by the transfer functions if arbitration was lost to another master on every attempt (only possible in multi-master mode).
+    static constexpr int16_t arbitrationLost = -2;
+
+    /// How many times a transfer is retried after losing arbitration before giving up.
+    static constexpr uint8_t maxArbitrationRetries = 3;
+
     private:
-    /// Listen for errors. For an I2C single master this is really just if we receive a NACK.
-    static bool err_occurred() {
+    /// Number of MCLK cycles to back off for after losing arbitration. Multiplied by the number of consecutive losses.
+    static constexpr uint16_t backoffCycles = 200;
+
+    enum class BusError {
+        None,
+        Nack,
+        ArbitrationLost,
+    };
+
+    /// Another master won arbitration, so the peripheral has switched itself to slave mode.
+    /// Wait for the other master to finish with the bus, then switch back to master mode.
+    static void recoverFromArbitrationLoss() {
+        while (IS_SET(STATW, UCBBUSY));
+        SET_BITS(CTLW0, UCSWRST);
+        SET_BITS(CTLW0, UCMST__MASTER);
+        CLEAR_BITS(CTLW0, UCSWRST);
+    }
+
+    /// Listen for errors. Either we receive a NACK, or (in multi-master mode) another master wins arbitration.
+    static BusError err_occurred() {
+        if (IS_SET(IFG, UCALIFG)) {
+            recoverFromArbitrationLoss();
+            return BusError::ArbitrationLost;
+        }
         if (IS_SET(IFG, UCNACKIFG)) {
             // Send stop and wait for it to finish
             SET_BITS(CTLW0, UCTXSTP_1);
             while(IS_SET(CTLW0, UCTXSTP));
-            return true;
+            return BusError::Nack;
+        }
+        return BusError::None;
+    }
+
+    /// Value to return for an error: the byte that was NACKed, or arbitrationLost.
+    static int16_t errResult(BusError err, int16_t nackedByte) {
+        return (err == BusError::ArbitrationLost) ? arbitrationLost : nackedByte;
+    }
+
+    /// If arbitration was lost and there are retries left, back off and return true so the caller tries again.
+    /// The backoff grows with each consecutive loss, which gives the other master a chance to finish a burst of transactions.
+    static bool shouldRetry(int16_t result, uint8_t attempt) {
+        if ((result != arbitrationLost) || (attempt >= maxArbitrationRetries)) {
+            return false;
+        }
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i <= attempt; i++) {
+            __delay_cycles(backoffCycles);
         }
-        return false;
+        #pragma diag_default 1544
+        while (IS_SET(STATW, UCBBUSY));
+        return true;
     }
 
     /// Edge case for zero byte writes (i.e. just the slave address byte)
@@ -67,20 +143,22 @@ struct I2cMaster {
         *TXBUF = 0; // Bus stalls if nothing Tx, even if a stop is scheduled
         // Wait for both STT and STP to go low, monitoring error flags
         while (IS_SET(CTLW0, UCTXSTT | UCTXSTP)) {
-            if (err_occurred()) {
-                return 0;
+            BusError err = err_occurred();
+            if (err != BusError::None) {
+                return errResult(err, 0);
             }
         }
-        if (err_occurred()) {
-            return 0;
+        BusError err = err_occurred();
+        if (err != BusError::None) {
+            return errResult(err, 0);
         }
         return -1;
     }
 
     /// Write some number of bytes to the slave. 
-    /// Returns -1 if OK, otherwise returns the byte where a NACK was received.
+    /// Returns -1 if OK, arbitrationLost if another master won the bus, otherwise returns the byte where a NACK was received.
     /// (i.e. 0 = slave address byte, 1 = first data byte, etc.)
-    static int16_t writeBytes(uint8_t address, uint8_t buf[], uint16_t len, bool sendStart, bool sendStop) {
+    static int16_t writeBytes(uint16_t address, const uint8_t buf[], uint16_t len, bool sendStart, bool sendStop) {
         // Clear old flags, set slave address and Tx mode
         *IFG = 0;
         *SA = address;
@@ -101,12 +179,13 @@ struct I2cMaster {
         for (uint16_t i = 0; i < len; i++) {
             // Wait for Tx buffer to be empty. Listen for errors while waiting.
             while (1) {
-                if (err_occurred()) {
+                BusError err = err_occurred();
+                if (err != BusError::None) {
                     // Subtract index because buffer fills before any NACKs come through
                     if (i > 0) {
-                        return i-1;
+                        return errResult(err, i-1);
                     } else {
-                        return 0;
+                        return errResult(err, 0);
                     }
                 }
                 if (IS_SET(IFG, UCTXIFG)) {
@@ -121,11 +200,12 @@ struct I2cMaster {
 
         // Check errors for last byte
         while (!IS_SET(IFG, UCTXIFG)) {
-            if (err_occurred()) {
+            BusError err = err_occurred();
+            if (err != BusError::None) {
                 if (len > 0) {
-                    return len-1;
+                    return errResult(err, len-1);
                 } else {
-                    return 0;
+                    return errResult(err, 0);
                 }
             }
         }
@@ -134,8 +214,9 @@ struct I2cMaster {
             // Send stop, and listen again for possible errors from that last byte
             SET_BITS(CTLW0, UCTXSTP_1);
             while (IS_SET(STATW, UCBUSY)) {
-                if (err_occurred()) {
-                    return len;
+                BusError err = err_occurred();
+                if (err != BusError::None) {
+                    return errResult(err, len);
                 }
             }
         }
@@ -143,9 +224,9 @@ struct I2cMaster {
     }
 
     /// Read some number of bytes from the slave. 
-    /// Returns -1 if OK, otherwise returns the byte where a NACK was received.
+    /// Returns -1 if OK, arbitrationLost if another master won the bus, otherwise returns the byte where a NACK was received.
     /// (i.e. 0 = slave address byte, 1 = first data byte, etc.)
-    static int16_t readBytes(uint8_t address, uint8_t buf[], uint16_t len, bool sendStart, bool sendStop) {
+    static int16_t readBytes(uint16_t address, uint8_t buf[], uint16_t len, bool sendStart, bool sendStop) {
         // Clear old flags, set slave address and Rx mode
         *IFG = 0;
         *SA = address;
@@ -153,7 +234,12 @@ struct I2cMaster {
 
         if (sendStart) {
             SET_BITS(CTLW0, UCTXSTT_1);
-            while(IS_SET(CTLW0, UCTXSTT));
+            while(IS_SET(CTLW0, UCTXSTT)) {
+                BusError err = err_occurred();
+                if (err != BusError::None) {
+                    return errResult(err, 0);
+                }
+            }
         }
 
         #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here. 
@@ -165,8 +251,9 @@ struct I2cMaster {
             }
             // Monitor error flags while waiting for the Rx flag
             while (1) {
-                if (err_occurred()) {
-                    return i;
+                BusError err = err_occurred();
+                if (err != BusError::None) {
+                    return errResult(err, i);
                 }
                 if (IS_SET(IFG, UCRXIFG)) {
                     break;
@@ -183,34 +270,8 @@ struct I2cMaster {
         return -1;
     }
 
-    public:
-    /// Initialise an I2C peripheral into master mode. This function assumes that the GPIO pins for SCL and SDA have been correctly configured.
-    /// Currently only supports 7-bit addressing.
-    static void init(
-        I2cClockSource clockSource,
-        uint16_t prescaler,
-        DeglitchTime glitchTime = DeglitchTime::_50ns) {
-        
-        uint16_t clk    = static_cast<uint16_t>(clockSource);
-        uint16_t glitch = static_cast<uint16_t>(glitchTime);
-        SET_BITS(CTLW0, UCSWRST);
-
-        //     |     7-bit addressing    | Single master |  master mode  |     I2C mode       | clock source | 
-        *CTLW0 = UCA10_0 | UCSLA10__7BIT | UCMM__SINGLE  | UCMST__MASTER | UCMODE_3 | UCSYNC  |      clk     | UCSWRST;
-        
-        //       | No timeout | glitch filter
-        *CTLW1 =    UCCLTO_0  | glitch;
-
-        *BRW = prescaler;
-
-        CLEAR_BITS(CTLW0, UCSWRST);
-    }
-
-    /// Perform an arbitrary number of read and write operations to the device at `address` in a single I2C transaction.
-    /// A Start is sent before the first operation, and between operations of dissimilar types (i.e. Read -> Write causes a repeated start).
-    /// A Stop is sent after the last operation.
-    /// Returns -1 if no NACKs were received, otherwise returns the byte number from which the NACK was received.
-    static int16_t transaction(uint8_t address, I2cOperation operations[], uint16_t len) {
+    /// A single attempt at transaction(). See transaction() for details.
+    static int16_t attemptTransaction(uint16_t address, const I2cOperation operations[], uint16_t len) {
         // Total number of bytes sent so far. Used to correctly offset the byte counter in case of an error.
         int16_t bytesSent = 0;
         #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here. 
@@ -225,12 +286,16 @@ struct I2cMaster {
             // Only send a stop if this is the last operation
             bool sendStop = (i == len-1);
             
-            I2cOperation op = operations[i];
+            const I2cOperation& op = operations[i];
             int16_t result;
             if (op.dir == I2cDirection::Transmit) {
-                result = writeBytes(address, op.data, op.len, sendStart, sendStop);
+                result = writeBytes(address, op.send, op.len, sendStart, sendStop);
             } else {
-                result = readBytes(address, op.data, op.len, sendStart, sendStop);
+                result = readBytes(address, op.recv, op.len, sendStart, sendStop);
+            }
+
+            if (result == arbitrationLost) {
+                return result;
             }
 
             // If err, make the count match the total number of bytes sent
@@ -244,31 +309,109 @@ struct I2cMaster {
         return -1;
     }
 
+    /// A single attempt at write_read(). See write_read() for details.
+    static int16_t attemptWriteRead(uint16_t address, const uint8_t send[], uint16_t sendLen, uint8_t recv[], uint16_t recvLen) {
+        int16_t result = writeBytes(address, send, sendLen, true, false);
+        if (result != -1) {
+            return result;
+        }
+        result = readBytes(address, recv, recvLen, true, true);
+        if (result == arbitrationLost) {
+            return result;
+        }
+        if (result != -1) {
+            return sendLen + result;
+        }
+        return -1;
+    }
+
+    public:
+    /// Initialise an I2C peripheral into master mode. This function assumes that the GPIO pins for SCL and SDA have been correctly configured.
+    /// `addressing` sets whether slave addresses are 7 or 10 bits long. 
+    /// In multi-master mode, losing arbitration to another master is detected and the transfer is retried after the bus is free again.
+    static void init(
+        I2cClockSource clockSource,
+        uint16_t prescaler,
+        DeglitchTime glitchTime = DeglitchTime::_50ns,
+        I2cAddressing addressing = I2cAddressing::_7Bit,
+        I2cBusMode busMode = I2cBusMode::SingleMaster) {
+        
+        uint16_t clk    = static_cast<uint16_t>(clockSource);
+        uint16_t glitch = static_cast<uint16_t>(glitchTime);
+        uint16_t sla10  = static_cast<uint16_t>(addressing);
+        uint16_t mm     = static_cast<uint16_t>(busMode);
+        SET_BITS(CTLW0, UCSWRST);
+
+        //     | 7-bit own addr | Slave addr size | Multi master |  master mode  |     I2C mode       | clock source | 
+        *CTLW0 =     UCA10_0    |      sla10      |      mm      | UCMST__MASTER | UCMODE_3 | UCSYNC  |      clk     | UCSWRST;
+        
+        //       | No timeout | glitch filter
+        *CTLW1 =    UCCLTO_0  | glitch;
+
+        *BRW = prescaler;
+
+        CLEAR_BITS(CTLW0, UCSWRST);
+    }
+
+    /// Change the clock prescaler, e.g. after the source clock frequency has changed. Waits for the bus to be idle first.
+    /// Resetting the peripheral clears its interrupt enables, so they are restored afterwards.
+    static void setPrescaler(uint16_t prescaler) {
+        while (IS_SET(STATW, UCBBUSY));
+        uint16_t ie = *IE;
+        SET_BITS(CTLW0, UCSWRST);
+        *BRW = prescaler;
+        CLEAR_BITS(CTLW0, UCSWRST);
+        *IE = ie;
+    }
+
+    /// Perform an arbitrary number of read and write operations to the device at `address` in a single I2C transaction.
+    /// A Start is sent before the first operation, and between operations of dissimilar types (i.e. Read -> Write causes a repeated start).
+    /// A Stop is sent after the last operation.
+    /// If arbitration is lost to another master the whole transaction is restarted, up to maxArbitrationRetries times.
+    /// Returns -1 if no NACKs were received, arbitrationLost if every attempt lost arbitration, 
+    /// otherwise returns the byte number from which the NACK was received.
+    /// Neither `operations` nor the bytes of Transmit operations are written to, so both can be `const` tables in FRAM.
+    static int16_t transaction(uint16_t address, const I2cOperation operations[], uint16_t len) {
+        int16_t result;
+        uint8_t attempt = 0;
+        do {
+            result = attemptTransaction(address, operations, len);
+        } while (shouldRetry(result, attempt++));
+        return result;
+    }
+
     /// Send a Start, write `len` bytes to the device at `address`, then send a Stop.
-    /// Returns -1 if no NACKs were received, otherwise returns the byte number from which the NACK was received.
-    static int16_t write(uint8_t address, uint8_t buf[], uint16_t len) {
-        I2cOperation op = {I2cDirection::Transmit, buf, len};
-        I2cOperation ops[1] = { op };
-        return transaction(address, ops, 1);
+    /// Returns -1 if no NACKs were received, arbitrationLost if every attempt lost arbitration, 
+    /// otherwise returns the byte number from which the NACK was received.
+    /// `buf` is never written to, so it can point directly into a `const` table in FRAM.
+    static int16_t write(uint16_t address, const uint8_t buf[], uint16_t len) {
+        int16_t result;
+        uint8_t attempt = 0;
+        do {
+            result = writeBytes(address, buf, len, true, true);
+        } while (shouldRetry(result, attempt++));
+        return result;
     }
 
     /// Sent a Start, read `len` bytes from the device at `address`, then send a Stop.
-    /// Returns -1 if no NACKs were received, otherwise returns the byte number from which the NACK was received.
-    static int16_t read(uint8_t address, uint8_t buf[], uint16_t len) {
-        I2cOperation op = {I2cDirection::Receive, buf, len};
-        I2cOperation ops[1] = { op };
+    /// Returns -1 if no NACKs were received, arbitrationLost if every attempt lost arbitration, 
+    /// otherwise returns the byte number from which the NACK was received.
+    static int16_t read(uint16_t address, uint8_t buf[], uint16_t len) {
+        I2cOperation ops[1] = { I2cOperation::receive(buf, len) };
         return transaction(address, ops, 1);
     }
 
     /// Send a Start, write `sendLen` bytes to the device at `address`, send a repeated start and read `recvLen` bytes, then send a Stop.
     /// Commonly used for operations like reading register values, etc.
-    /// Returns -1 if no NACKs were received, otherwise returns the byte number from which the NACK was received.
-    static int16_t write_read(uint8_t address, uint8_t send[], uint16_t sendLen, uint8_t recv[], uint16_t recvLen) {
-        I2cOperation ops[2] = { 
-            {I2cDirection::Transmit, send, sendLen},
-            {I2cDirection::Receive,  recv, recvLen},
-        };
-        return transaction(address, ops, 2);
+    /// Returns -1 if no NACKs were received, arbitrationLost if every attempt lost arbitration, 
+    /// otherwise returns the byte number from which the NACK was received.
+    static int16_t write_read(uint16_t address, const uint8_t send[], uint16_t sendLen, uint8_t recv[], uint16_t recvLen) {
+        int16_t result;
+        uint8_t attempt = 0;
+        do {
+            result = attemptWriteRead(address, send, sendLen, recv, recvLen);
+        } while (shouldRetry(result, attempt++));
+        return result;
     }
 };
 
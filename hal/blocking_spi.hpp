@@ -75,6 +75,17 @@ struct SpiMaster {
         CLEAR_BITS(CTLW0, UCSWRST);
     }
 
+    /// Change the clock prescaler, e.g. after the source clock frequency has changed. Waits for any transfer in progress to finish first.
+    /// Resetting the peripheral clears its interrupt enables, so they are restored afterwards.
+    static void setPrescaler(uint16_t prescaler) {
+        while (IS_SET(STATW, UCBUSY));
+        uint16_t ie = *IE;
+        SET_BITS(CTLW0, UCSWRST);
+        *BRW0 = prescaler;
+        CLEAR_BITS(CTLW0, UCSWRST);
+        *IE = ie;
+    }
+
     /// Send and recieve a single byte. Does not manage the chip select pin.
     static uint8_t transferByte(uint8_t data) {
         while(txBufFull());
@@ -8,6 +8,9 @@
 #include "gpio.hpp"
 #include "eusci.hpp"
 
+// Defined in delay.hpp. Only the timeout overloads use it, so UART users that don't need timeouts don't pull in the Timebase.
+struct Deadline;
+
 enum StopBits {
     OneStop = UCSPB_0,
     TwoStop = UCSPB_1,
@@ -25,6 +28,12 @@ struct BaudConfig {
     uint8_t  ucbrf;
     bool ucos16;
 
+    /// Calculates the BaudConfig for `baud` from a `clockHz` source clock, using the algorithm in section 22.3.10 of the user manual.
+    /// With a ClockConfig this is evaluated at compile time, e.g. `constexpr BaudConfig baud = BaudConfig::calculate(SystemClock::smclkHz, 115200);`
+    static constexpr BaudConfig calculate(uint32_t clockHz, uint32_t baud) {
+        return calculateFromDivisor(clockHz / baud, uint16_t((uint64_t(clockHz % baud) * 10000) / baud));
+    }
+
     /// Returns a BaudConfig for 9600 baud when SMCLK at the default speed (1.048576 MHz)
     static BaudConfig defaultSmclk9600Baud() {
         return {ucos16: true, ucbr: 6, ucbrf: 13, ucbrs: 0x22};
@@ -34,6 +43,27 @@ struct BaudConfig {
     static BaudConfig defaultSmclk115200Baud() {
         return {ucos16: false, ucbr: 9, ucbrf: 0, ucbrs: 0x08};
     }
+
+    private:
+    /// UCBRSx for the fractional part of the divisor, in units of 1/10000. See table 22-4 of the user manual.
+    static constexpr uint8_t ucbrsFor(uint16_t frac) {
+        return (frac >= 9288) ? 0xFE : (frac >= 9170) ? 0xFD : (frac >= 9004) ? 0xFB : (frac >= 8751) ? 0xF7 :
+               (frac >= 8572) ? 0xEF : (frac >= 8464) ? 0xDF : (frac >= 8333) ? 0xBF : (frac >= 8004) ? 0xEE :
+               (frac >= 7861) ? 0xED : (frac >= 7503) ? 0xDD : (frac >= 7147) ? 0xBB : (frac >= 7001) ? 0xB7 :
+               (frac >= 6667) ? 0xD6 : (frac >= 6432) ? 0xB6 : (frac >= 6254) ? 0xB5 : (frac >= 6003) ? 0xAD :
+               (frac >= 5715) ? 0x6B : (frac >= 5002) ? 0xAA : (frac >= 4378) ? 0x55 : (frac >= 4286) ? 0x53 :
+               (frac >= 4003) ? 0x92 : (frac >= 3753) ? 0x52 : (frac >= 3575) ? 0x4A : (frac >= 3335) ? 0x49 :
+               (frac >= 3000) ? 0x25 : (frac >= 2503) ? 0x44 : (frac >= 2224) ? 0x22 : (frac >= 2147) ? 0x21 :
+               (frac >= 1670) ? 0x11 : (frac >= 1430) ? 0x20 : (frac >= 1252) ? 0x10 : (frac >= 1001) ? 0x08 :
+               (frac >=  835) ? 0x04 : (frac >=  715) ? 0x02 : (frac >=  529) ? 0x01 : 0x00;
+    }
+
+    /// `n` is the integer part of clock / baud, `frac` the fractional part in units of 1/10000.
+    static constexpr BaudConfig calculateFromDivisor(uint32_t n, uint16_t frac) {
+        // Oversampling mode when the divisor is large enough, which samples each bit 16 times
+        return (n >= 16) ? BaudConfig{uint16_t(n / 16), ucbrsFor(frac), uint8_t(n % 16), true}
+                         : BaudConfig{uint16_t(n),      ucbrsFor(frac), 0,               false};
+    }
 };
 
 
@@ -91,6 +121,18 @@ struct Uart {
         CLEAR_BITS(CTLW0, UCSWRST);
     }
 
+    /// Change the baud rate, e.g. after the source clock frequency has changed. Waits for any byte being sent to finish first.
+    /// Resetting the peripheral clears its interrupt enables, so they are restored afterwards.
+    static void setBaud(const BaudConfig& baud) {
+        flush();
+        uint16_t ie = *IE;
+        SET_BITS(CTLW0, UCSWRST);
+        *BRW = baud.ucbr;
+        *MCTLW = uint16_t(baud.ucbrs) << 8 | (baud.ucbrf & 0x0F) << 4 | baud.ucos16;
+        CLEAR_BITS(CTLW0, UCSWRST);
+        *IE = ie;
+    }
+
     static bool txBufFull() {
         return (*IFG & UCTXIFG) == 0;
     }
@@ -111,6 +153,19 @@ struct Uart {
         return *RXBUF;
     }
 
+    /// Wait for a single byte from the UART channel until `deadline`. Returns true if a byte was received into `byte`.
+    /// Include delay.hpp to use it. `D` is always Deadline: it's a template parameter so the body is only compiled once Deadline is complete.
+    template<typename D = Deadline>
+    static bool readByte(uint8_t& byte, const D& deadline) {
+        while (rxBufEmpty()) {
+            if (deadline.expired()) {
+                return false;
+            }
+        }
+        byte = *RXBUF;
+        return true;
+    }
+
     /// Block until any previously buffered bytes have been written to the UART channel.
     static void flush() {
         while( IS_SET(STATW, UCBUSY) );
@@ -133,6 +188,19 @@ struct Uart {
         }
         #pragma diag_default 1544
     }
+
+    /// Receive up to `len` bytes from the UART channel, giving up at `deadline`. Returns the number of bytes received. Include delay.hpp to use it.
+    template<typename D = Deadline>
+    static uint16_t read(uint8_t recv[], uint16_t len, const D& deadline) {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here. 
+        for (uint16_t i = 0; i < len; i++) {
+            if (!readByte(recv[i], deadline)) {
+                return i;
+            }
+        }
+        #pragma diag_default 1544
+        return len;
+    }
 };
 
 #endif
@@ -0,0 +1,318 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "timer_b.hpp"
+
+/// One measurement from a CaptureMeter, in timer ticks.
+struct CaptureResult {
+    /// Total length of the measured periods. 0 if the input has stopped.
+    uint32_t ticks;
+    /// Number of whole periods measured.
+    uint16_t periods;
+    /// Time the input spent high during those periods. Only measured if duty cycle measurement is enabled.
+    uint32_t highTicks;
+
+    /// Average period in ticks, or 0 if the input has stopped.
+    uint32_t periodTicks() const {
+        return (periods != 0) ? (ticks / periods) : 0;
+    }
+
+    /// Average frequency in Hz, rounded to the nearest Hz, for a timer tick frequency of `tickHz`. 0 if the input has stopped.
+    uint32_t frequencyHz(uint32_t tickHz) const {
+        return (ticks != 0) ? uint32_t((uint64_t(tickHz) * periods + ticks / 2) / ticks) : 0;
+    }
+
+    /// Average frequency in mHz, for slow inputs such as anemometers. 0 if the input has stopped.
+    uint32_t frequencyMilliHz(uint32_t tickHz) const {
+        return (ticks != 0) ? uint32_t((uint64_t(tickHz) * 1000 * periods + ticks / 2) / ticks) : 0;
+    }
+
+    /// Average duty cycle, where 0xFFFF is (almost) always high.
+    uint16_t dutyFraction() const {
+        if (ticks == 0) {
+            return 0;
+        }
+        uint32_t fraction = uint32_t((uint64_t(highTicks) << 16) / ticks);
+        return (fraction > 0xFFFF) ? 0xFFFF : uint16_t(fraction);
+    }
+};
+
+/// Measures the period, frequency, and duty cycle of a digital input by timestamping its edges in hardware, with channel `Channel` of a Timer_B
+/// in capture mode. Unlike counting GPIO interrupts, the timestamps are exact to the timer tick however late the interrupt runs.
+/// The timer runs continuously from `Source` / `Divider`, and is extended to 32 bits by its overflow interrupt, so periods of any length can be measured.
+/// Each result averages `Periods` periods (rising edge to rising edge). Only the first and last edges matter for the average, so it costs nothing extra.
+///
+/// Results are published from the interrupt, so they're always up to date without any help from the main loop: read them with readLatest().
+/// If no edge arrives for the timeout set in start(), a result of 0 is published to show the input has stopped.
+///
+/// Connect the pin to the channel's A input with PinFunction (e.g. CCI1A-CCI6A of TB3 are P6.0-P6.5), and forward the timer's TIMERx_B1
+/// interrupt to handleInterrupt(). The meter uses the whole timer.
+/// ```
+/// using FlowMeter = CaptureMeter<TimerB<TIMER_B3>, 1, 8>; // Average over 8 periods
+/// Pin<P6,0>::toInput().function(PinFunction::Primary);
+/// FlowMeter::start(true, 400);
+/// ...
+/// CaptureResult result;
+/// if (FlowMeter::readLatest(result)) {
+///     uint32_t hz = result.frequencyHz(FlowMeter::tickHz(SystemClock::smclkHz));
+/// }
+/// ```
+template<
+    typename Timer,
+    uint8_t Channel,
+    uint16_t Periods = 1,
+    CaptureInput Input = CaptureInput::A,
+    TimerClockSource Source = TimerClockSource::Smclk,
+    uint8_t Divider = 1
+>
+struct CaptureMeter {
+    static_assert((Channel >= 1) && (Channel < Timer::channels), "Use channels 1 and up, which share the overflow's interrupt vector");
+    static_assert(Periods >= 1, "Measure at least one period");
+
+    using Config = TimerConfig<Source, TimerMode::Continuous, Divider, TimerCounterLength::_16Bit, true>;
+
+    /// Timer tick frequency in Hz, for a source clock of `sourceHz`.
+    static constexpr uint32_t tickHz(uint32_t sourceHz) {
+        return Config::tickHz(sourceHz);
+    }
+
+    private:
+    struct State {
+        /// The upper 16 bits of the timer count
+        uint16_t high;
+        bool measureDuty;
+        /// True once the first rising edge of a window has been seen
+        bool started;
+        /// When capturing both edges: true once the polarity of the edges is known, so that the next one can be told by alternation
+        bool synced;
+        /// When synced, whether the next edge is rising
+        bool nextRising;
+        uint32_t windowStart;
+        uint32_t lastRise;
+        uint16_t periods;
+        uint32_t highTicks;
+        uint16_t timeoutOverflows;
+        uint16_t idleOverflows;
+        /// Volatile like the sequence, so that readLatest() really reads it again each time round its retry loop
+        volatile CaptureResult result;
+        volatile uint16_t sequence;
+    };
+    static State s;
+
+    static void publish(uint32_t ticks, uint16_t periods, uint32_t highTicks) {
+        s.result.ticks = ticks;
+        s.result.periods = periods;
+        s.result.highTicks = highTicks;
+        if (++s.sequence == 0) {
+            s.sequence = 1;
+        }
+    }
+
+    static void onCapture() {
+        uint16_t low = Timer::template capturedValue<Channel>();
+        // The input level only says which edge this was if no other edge has been captured since: then the flag is still clear
+        bool level = Timer::template captureInput<Channel>();
+        bool ambiguous = Timer::template flagSet<Channel>();
+        uint16_t high = s.high;
+        // A pending overflow with a small capture means the overflow happened first
+        if (Timer::overflowFlagSet() && (low < 0x8000)) {
+            high++;
+        }
+        uint32_t timestamp = (uint32_t(high) << 16) | low;
+        s.idleOverflows = 0;
+
+        if (Timer::template captureOverflowed<Channel>()) {
+            // An edge was missed, so the window can't be trusted, and neither can the alternation of the edges. Start again.
+            s.started = false;
+            s.synced = false;
+        }
+
+        bool rising = true;
+        if (s.measureDuty) {
+            if (ambiguous) {
+                // Another edge came in while this one was read, so the captured value or the level may belong to it. Wait for a quiet edge.
+                s.started = false;
+                s.synced = false;
+                return;
+            }
+            // Edges alternate, so the input level is only needed to find the first one's polarity. By the time a later interrupt reads it,
+            // a short pulse may already have ended.
+            rising = s.synced ? s.nextRising : level;
+            s.synced = true;
+            s.nextRising = !rising;
+        }
+
+        if (!rising) {
+            if (s.started) {
+                s.highTicks += timestamp - s.lastRise;
+            }
+            return;
+        }
+        if (s.started && (++s.periods >= Periods)) {
+            publish(timestamp - s.windowStart, s.periods, s.highTicks);
+            s.started = false;
+        }
+        if (!s.started) {
+            s.windowStart = timestamp;
+            s.periods = 0;
+            s.highTicks = 0;
+            s.started = true;
+        }
+        s.lastRise = timestamp;
+    }
+
+    static void onOverflow() {
+        s.high++;
+        if ((s.timeoutOverflows != 0) && (++s.idleOverflows == s.timeoutOverflows)) {
+            publish(0, 0, 0);
+            s.started = false;
+        }
+    }
+
+    public:
+    /// Start measuring. With `measureDuty`, both edges are captured so the duty cycle can be measured as well, which doubles the interrupt rate.
+    /// If no edge arrives for `timeoutOverflows` timer overflows (each 65536 ticks), a result of 0 is published. 0 disables the timeout.
+    static void start(bool measureDuty = true, uint16_t timeoutOverflows = 0) {
+        s.high = 0;
+        s.measureDuty = measureDuty;
+        s.started = false;
+        s.synced = false;
+        s.timeoutOverflows = timeoutOverflows;
+        s.idleOverflows = 0;
+        s.sequence = 0;
+        Timer::template init<Config>();
+        Timer::template configureCapture<Channel>(measureDuty ? CaptureEdge::Both : CaptureEdge::Rising, Input);
+        Timer::template captureOverflowed<Channel>();
+        Timer::template enableInterrupt<Channel>();
+        Timer::template start<Config>();
+    }
+
+    /// Stop measuring.
+    static void stop() {
+        Timer::template disableInterrupt<Channel>();
+        Timer::template stop<Config>();
+    }
+
+    /// Call this from the timer's TIMERx_B1 interrupt. Measurements never need the CPU to wake, so always returns false.
+    static bool handleInterrupt() {
+        switch (Timer::pendingInterrupt()) {
+            case Channel:
+                onCapture();
+                return false;
+            case Timer::overflowInterrupt:
+                onOverflow();
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    /// Copy the latest result into `result`. Returns false if there hasn't been a result since start().
+    static bool readLatest(CaptureResult& result) {
+        uint16_t seq;
+        do {
+            seq = s.sequence;
+            result.ticks = s.result.ticks;
+            result.periods = s.result.periods;
+            result.highTicks = s.result.highTicks;
+        } while (seq != s.sequence);
+        return seq != 0;
+    }
+
+    /// Increases by one with each new result (skipping 0), so callers can tell whether a result is new.
+    static uint16_t sequence() {
+        return s.sequence;
+    }
+};
+
+template<typename Timer, uint8_t Channel, uint16_t Periods, CaptureInput Input, TimerClockSource Source, uint8_t Divider>
+typename CaptureMeter<Timer, Channel, Periods, Input, Source, Divider>::State CaptureMeter<Timer, Channel, Periods, Input, Source, Divider>::s;
+
+/// Measures high frequencies by counting edges over a fixed gate time, which suits inputs too fast to interrupt on every period.
+/// The input drives the timer's clock directly (its TBxCLK pin, connected with PinFunction), so edges are counted in hardware up to the timer's
+/// maximum input frequency. The count is extended to 32 bits by the overflow interrupt.
+///
+/// Call gate() from any periodic interrupt (e.g. a TimerWheel timer, or the watchdog interval timer): each call publishes the number of
+/// edges since the previous call. Frequency = edges * gate frequency. Forward the timer's TIMERx_B1 interrupt to handleInterrupt().
+template<typename Timer, TimerClockSource Source = TimerClockSource::ExternalTbClk>
+struct GatedCounter {
+    static_assert((Source == TimerClockSource::ExternalTbClk) || (Source == TimerClockSource::InvertedTbClk), "A gated counter counts the TBxCLK input");
+
+    using Config = TimerConfig<Source, TimerMode::Continuous, 1, TimerCounterLength::_16Bit, true>;
+
+    private:
+    struct State {
+        volatile uint16_t high;
+        uint32_t lastCount;
+        /// Volatile like the sequence, so that readLatest() really reads it again each time round its retry loop
+        volatile uint32_t edges;
+        volatile uint16_t sequence;
+    };
+    static State s;
+
+    static uint32_t count() {
+        uint16_t high = s.high;
+        uint16_t low = Timer::count();
+        if (Timer::overflowFlagSet()) {
+            // The counter has overflowed, but the interrupt hasn't run yet. Read again in case the overflow happened after the first read.
+            low = Timer::count();
+            high++;
+        }
+        return (uint32_t(high) << 16) | low;
+    }
+
+    public:
+    /// Start counting. The first gate() after this publishes the edges since start().
+    static void start() {
+        s.high = 0;
+        s.lastCount = 0;
+        s.sequence = 0;
+        Timer::template init<Config>();
+        Timer::template start<Config>();
+    }
+
+    static void stop() {
+        Timer::template stop<Config>();
+    }
+
+    /// Call this from the timer's TIMERx_B1 interrupt. Always returns false.
+    static bool handleInterrupt() {
+        if (Timer::pendingInterrupt() == Timer::overflowInterrupt) {
+            s.high++;
+        }
+        return false;
+    }
+
+    /// Close the current gate and open the next one. Call this at a fixed rate, from an interrupt (or with interrupts disabled).
+    static void gate() {
+        uint32_t now = count();
+        s.edges = now - s.lastCount;
+        s.lastCount = now;
+        if (++s.sequence == 0) {
+            s.sequence = 1;
+        }
+    }
+
+    /// Copy the number of edges in the last complete gate into `edges`. Returns false if no gate has completed since start().
+    static bool readLatest(uint32_t& edges) {
+        uint16_t seq;
+        do {
+            seq = s.sequence;
+            edges = s.edges;
+        } while (seq != s.sequence);
+        return seq != 0;
+    }
+
+    /// Increases by one with each gate (skipping 0), so callers can tell whether a result is new.
+    static uint16_t sequence() {
+        return s.sequence;
+    }
+};
+
+template<typename Timer, TimerClockSource Source>
+typename GatedCounter<Timer, Source>::State GatedCounter<Timer, Source>::s;
+
+#endif /* CAPTURE_HPP */
@@ -4,25 +4,199 @@
 #include <msp430.h>
 #include <stdint.h>
 
+/// How much to divide DCOCLKDIV by to produce MCLK
+enum class MclkDivider {
+    _1   = DIVM__1,
+    _2   = DIVM__2,
+    _4   = DIVM__4,
+    _8   = DIVM__8,
+    _16  = DIVM__16,
+    _32  = DIVM__32,
+    _64  = DIVM__64,
+    _128 = DIVM__128,
+};
+
+/// How much to divide MCLK by to produce SMCLK
+enum class SmclkDivider {
+    _1 = DIVS__1,
+    _2 = DIVS__2,
+    _4 = DIVS__4,
+    _8 = DIVS__8,
+};
+
+/// Which clock the FLL locks the DCO to. This also sources ACLK.
+enum class FllReference {
+    /// The internal 32768Hz REFO oscillator
+    Refo = SELREF__REFOCLK,
+    /// A 32768Hz watch crystal on XT1, which is far more accurate than REFO. Start it with Xt1::start() first.
+    Xt1  = SELREF__XT1CLK,
+};
+
+/// The MCLK frequency that busy-waits (delayUs(), delayMs() and InitSequence's Delay steps) assume when they aren't given one.
+/// The default matches the default 1.048576 MHz MCLK. If the application runs at another fixed frequency, define this
+/// for the whole project (e.g. `--define=HAL_MCLK_HZ=24000000`) or pass the ClockConfig to each delay instead.
+#ifndef HAL_MCLK_HZ
+#define HAL_MCLK_HZ 1048576
+#endif
+
+// Internal implementation details
+namespace detail {
+    /// Number of MCLK cycles in `us` microseconds at `mclkHz`, rounded to the nearest cycle.
+    constexpr uint32_t cyclesForUs(uint32_t mclkHz, uint32_t us) {
+        return uint32_t((uint64_t(mclkHz) * us + 500000) / 1000000);
+    }
+
+    /// Number of MCLK cycles in `ms` milliseconds at `mclkHz`, rounded to the nearest cycle.
+    constexpr uint32_t cyclesForMs(uint32_t mclkHz, uint32_t ms) {
+        return uint32_t((uint64_t(mclkHz) * ms + 500) / 1000);
+    }
+
+    /// The FLL reference clock frequency. REFOCLK and a watch crystal on XT1 are both 32768Hz.
+    constexpr uint32_t fllRefFreqHz = 32768;
+
+    /// DCORSEL range for a DCO frequency. See section 3.2.5 of the user manual.
+    constexpr uint16_t dcorsel(uint32_t dcoFreqHz) {
+        return (dcoFreqHz <=  1500000) ? DCORSEL_0 :
+               (dcoFreqHz <=  3000000) ? DCORSEL_1 :
+               (dcoFreqHz <=  6000000) ? DCORSEL_2 :
+               (dcoFreqHz <= 10000000) ? DCORSEL_3 :
+               (dcoFreqHz <= 14000000) ? DCORSEL_4 :
+               (dcoFreqHz <= 18000000) ? DCORSEL_5 :
+               (dcoFreqHz <= 22000000) ? DCORSEL_6 : DCORSEL_7;
+    }
+
+    /// The FRAM on the MSP430 can only operate at 8MHz, so if the CPU goes faster we have to add some delays.
+    /// See section 5.3 of the MSP430FR2355 datasheet for details
+    constexpr uint16_t nwaits(uint32_t mclkFreqHz) {
+        return (mclkFreqHz > 16000000) ? NWAITS_2 :
+               (mclkFreqHz >  8000000) ? NWAITS_1 : NWAITS_0;
+    }
+
+    constexpr uint8_t mclkDividerShift(MclkDivider divider) {
+        return (divider == MclkDivider::_1)  ? 0 : (divider == MclkDivider::_2)  ? 1 :
+               (divider == MclkDivider::_4)  ? 2 : (divider == MclkDivider::_8)  ? 3 :
+               (divider == MclkDivider::_16) ? 4 : (divider == MclkDivider::_32) ? 5 :
+               (divider == MclkDivider::_64) ? 6 : 7;
+    }
+
+    constexpr uint8_t smclkDividerShift(SmclkDivider divider) {
+        return (divider == SmclkDivider::_1) ? 0 : (divider == SmclkDivider::_2) ? 1 :
+               (divider == SmclkDivider::_4) ? 2 : 3;
+    }
+
+    /// Change the FRAM wait states. Wait states must be added before MCLK speeds up, and can only be removed once it has slowed down.
+    inline void setFramWaitStates(uint16_t waits) {
+        FRCTL0 = FRCTLPW | waits;
+    }
+}
+
 /// Wait until the FLL has locked onto the target frequency
-void waitForFllLock() {
+inline void waitForFllLock() {
     while ((CSCTL7 & FLLUNLOCK) != FLLUNLOCK_0);
 }
 
+/// A complete clock tree configuration, fixed at compile time: the DCO is locked by the FLL to a multiple of the reference clock,
+/// MCLK is the DCO divided by `McDiv`, and SMCLK is MCLK divided by `SmDiv`. ACLK is the reference clock (REFO or XT1).
+/// Every derived frequency and register value is a constant, so drivers can calculate their dividers at compile time
+/// from one source of truth, e.g. `BaudConfig::calculate(SystemClock::smclkHz, 115200)`.
+/// ```
+/// using SystemClock = ClockConfig<24000000>; // 24MHz MCLK and SMCLK
+/// SystemClock::apply();
+/// ```
+/// The DCO frequency is rounded down to a multiple of 32768Hz; `dcoHz` gives the exact frequency.
+template<uint32_t DcoHz, MclkDivider McDiv = MclkDivider::_1, SmclkDivider SmDiv = SmclkDivider::_1, FllReference Reference = FllReference::Refo>
+struct ClockConfig {
+    static_assert(DcoHz >= 32768 * 2 && DcoHz <= 24000000, "The DCO frequency must be between 65kHz and 24MHz");
+
+    /// FLL reference (and ACLK) frequency in Hz.
+    static constexpr uint32_t refHz = detail::fllRefFreqHz;
+    /// FLL multiplier register value: DCO = (flln + 1) * refHz.
+    static constexpr uint16_t flln = uint16_t(DcoHz / refHz - 1);
+    /// Exact DCO frequency in Hz.
+    static constexpr uint32_t dcoHz = (uint32_t(flln) + 1) * refHz;
+    /// MCLK (CPU) frequency in Hz.
+    static constexpr uint32_t mclkHz = dcoHz >> detail::mclkDividerShift(McDiv);
+    /// SMCLK frequency in Hz.
+    static constexpr uint32_t smclkHz = mclkHz >> detail::smclkDividerShift(SmDiv);
+    /// ACLK frequency in Hz.
+    static constexpr uint32_t aclkHz = refHz;
+    /// DCO frequency range register value.
+    static constexpr uint16_t dcorsel = detail::dcorsel(dcoHz);
+    /// FRAM wait states register value.
+    static constexpr uint16_t nwaits = detail::nwaits(mclkHz);
+    /// Number of MCLK cycles in a millisecond, rounded to the nearest cycle.
+    static constexpr uint32_t cyclesPerMs = detail::cyclesForMs(mclkHz, 1);
+
+    /// Number of MCLK cycles in `us` microseconds, rounded to the nearest cycle.
+    static constexpr uint32_t cyclesForUs(uint32_t us) {
+        return detail::cyclesForUs(mclkHz, us);
+    }
+
+    /// Switch the clock system to this configuration. The FRAM wait states are changed in the safe order around the frequency change.
+    /// By default this waits for the FLL to lock, which can take a while. Otherwise call waitForFllLock() before relying on the frequency.
+    /// When lowering the frequency without waiting, the extra FRAM wait states of the old frequency are kept, which is safe but slightly slower.
+    /// See FllRelock for a non-blocking alternative which also trims the DCO.
+    static void apply(bool waitUntilStabilised = true) {
+        beginChange();
+        if (waitUntilStabilised) {
+            waitForFllLock();
+            finishChange();
+        }
+    }
+
+    /// First half of apply(): add any FRAM wait states needed, then reprogram the FLL and dividers. The FLL starts locking to the new frequency immediately.
+    static void beginChange() {
+        if (nwaits > (FRCTL0 & NWAITS)) {
+            detail::setFramWaitStates(nwaits);
+        }
+
+        // Disable FLL. This is needed to prevent the FLL from acting as we make modifications to the clock setup
+        __bis_SR_register(SCG0);
+        CSCTL3 = (CSCTL3 & ~SELREF) | static_cast<uint16_t>(Reference);
+        // Clear DCO bits. These will be set by the FLL after it's re-enabled.
+        CSCTL0 = 0;
+        CSCTL1 = (CSCTL1 & ~DCORSEL) | dcorsel;
+        CSCTL2 = FLLD_0 | flln;
+        __delay_cycles(3);
+        // Re-enable FLL
+        __bic_SR_register(SCG0);
+
+        //       MCLK and SMCLK from DCOCLKDIV | ACLK from the FLL reference
+        CSCTL4 = SELMS__DCOCLKDIV           | ((Reference == FllReference::Xt1) ? SELA__XT1CLK : SELA__REFOCLK);
+        CSCTL5 = (CSCTL5 & ~(DIVM | DIVS)) | static_cast<uint16_t>(McDiv) | static_cast<uint16_t>(SmDiv);
+    }
+
+    /// Second half of apply(), once the FLL has locked: remove any FRAM wait states that are no longer needed.
+    static void finishChange() {
+        // Only safe to remove wait states once the DCO has settled at the lower frequency
+        if (nwaits < (FRCTL0 & NWAITS)) {
+            detail::setFramWaitStates(nwaits);
+        }
+    }
+};
+
+/// The clock configuration after reset: 1.048576MHz MCLK and SMCLK, from the DCO locked to REFO.
+using DefaultClockConfig = ClockConfig<1048576>;
+
 /// Change the DCOCLK frequency using FLL stabilisation. See section 3.2.5 and 3.2.5.1 in the user manual.
 /// Takes a target frequency between 33kHz and 24,000 kHz. It clamps the value between these.
 /// The function either waits for the desired frequency to stabilise (default) or can return immediately.
-void changeClockFreq(uint16_t targetFreqKHz, bool waitUntilStabilised = true) {
+/// Prefer ClockConfig when the frequency is known at compile time, so that peripherals can derive their settings from it.
+inline void changeClockFreq(uint16_t targetFreqKHz, bool waitUntilStabilised = true) {
     if (targetFreqKHz > 24000) {
         targetFreqKHz = 24000;
     }
     else if (targetFreqKHz < 33) {
         targetFreqKHz = 33;
     }
+    uint32_t targetFreqHz = uint32_t(targetFreqKHz) * 1000;
 
     // The FLL ensures that the clock frequency (relative to the ref clock) remains constant even as voltage/temp varies.
     // The FLL can use either REFOCLK or the external XT1CLK as its reference clock. We assume 32768Hz in either case.
-    const uint16_t fllRefFreq_hz = 32768;
+    uint16_t waits = detail::nwaits(targetFreqHz);
+    if (waits > (FRCTL0 & NWAITS)) {
+        detail::setFramWaitStates(waits);
+    }
 
     // Disable FLL. This is needed to prevent the FLL from acting as we make modifications to the clock setup
     __bis_SR_register(SCG0);
@@ -31,52 +205,20 @@ void changeClockFreq(uint16_t targetFreqKHz, bool waitUntilStabilised = true) {
     CSCTL0 &= ~DCO;
 
     // Tell the FLL how many multiples of the ref clock we want
-    CSCTL2 = ((uint32_t(targetFreqKHz)*1000 / fllRefFreq_hz) - 1);
+    CSCTL2 = ((targetFreqHz / detail::fllRefFreqHz) - 1);
 
     // Set coarse frequency regime
-    CSCTL1 &= ~DCORSEL; // Clear all DCORSEL bits
-    if (targetFreqKHz <= 1500) {
-        CSCTL1 |= DCORSEL_0;
-    }
-    else if (targetFreqKHz <= 3000) {
-        CSCTL1 |= DCORSEL_1;
-    }
-    else if (targetFreqKHz <= 6000) {
-        CSCTL1 |= DCORSEL_2;
-    }
-    else if (targetFreqKHz <= 10000) {
-        CSCTL1 |= DCORSEL_3;
-    }
-    else if (targetFreqKHz <= 14000) {
-        CSCTL1 |= DCORSEL_4;
-    }
-    else if (targetFreqKHz <= 18000) {
-        CSCTL1 |= DCORSEL_5;
-    }
-    else if (targetFreqKHz <= 22000) {
-        CSCTL1 |= DCORSEL_6;
-    }
-    else if (targetFreqKHz <= 24000) {
-        CSCTL1 |= DCORSEL_7;
-    }
-
-    // The FRAM on the MSP430 can only operate at 8MHz, so if the CPU goes faster we have to add some delays.
-    // See section 5.3 of the MSP430FR2355 datasheet for details
-    if (targetFreqKHz > 16000) {
-        FRCTL0 = FRCTLPW | NWAITS_2;
-    }
-    else if (targetFreqKHz > 8000) {
-        FRCTL0 = FRCTLPW | NWAITS_1;
-    }
-    else {
-        FRCTL0 = FRCTLPW | NWAITS_0;
-    }
+    CSCTL1 = (CSCTL1 & ~DCORSEL) | detail::dcorsel(targetFreqHz);
 
     // Re-enable FLL
     __bic_SR_register(SCG0);
 
-    if waitUntilStabilised {
+    if (waitUntilStabilised) {
         waitForFllLock();
+        // Only safe to remove wait states once the DCO has settled at the lower frequency
+        if (waits < (FRCTL0 & NWAITS)) {
+            detail::setFramWaitStates(waits);
+        }
     }
 }
 
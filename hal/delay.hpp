@@ -0,0 +1,298 @@
+#ifndef DELAY_HPP
+#define DELAY_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "clock.hpp"
+#include "timer_b.hpp"
+
+// Internal implementation details
+namespace detail {
+    /// Busy-wait for exactly `Cycles` MCLK cycles. __delay_cycles() needs a constant.
+    template<uint32_t Cycles>
+    inline void delayCycles() {
+        __delay_cycles(Cycles);
+    }
+
+    /// __delay_cycles() doesn't accept 0, so a delay that rounds down to no cycles does nothing.
+    template<>
+    inline void delayCycles<0>() {}
+}
+
+/// A free-running 32-bit tick count, from Timer_B0 counting ACLK (32768Hz) in continuous mode. The hardware counter is 16 bits,
+/// and its overflow interrupt extends it to 32 bits, so the count wraps after about 36 hours. ACLK keeps running in LPM3, and so does the count.
+/// Timebase takes over Timer_B0: CCR1 is used by sleepUntil(), and CCR2 by the alarm. Call start() during startup, and forward the TIMER0_B1 interrupt to handleInterrupt():
+/// ```
+/// #pragma vector=TIMER0_B1_VECTOR
+/// __interrupt void TIMER0_B1_ISR(void) {
+///     if (Timebase::handleInterrupt()) {
+///         __bic_SR_register_on_exit(LPM4_bits); // A sleep has reached its deadline, or the alarm has fired
+///     }
+/// }
+/// ```
+struct Timebase {
+    /// Ticks per second.
+    static constexpr uint32_t tickHz = detail::fllRefFreqHz;
+
+    /// Convert milliseconds to ticks at compile time, rounding up.
+    static constexpr uint32_t ticksForMs(uint32_t ms) {
+        return uint32_t((uint64_t(ms) * tickHz + 999) / 1000);
+    }
+
+    /// Convert microseconds to ticks at compile time, rounding up. One tick is about 30.5us.
+    static constexpr uint32_t ticksForUs(uint32_t us) {
+        return uint32_t((uint64_t(us) * tickHz + 999999) / 1000000);
+    }
+
+    private:
+    using Timer = TimerB<TIMER_B0>;
+    using Config = TimerConfig<TimerClockSource::Aclk, TimerMode::Continuous, 1, TimerCounterLength::_16Bit, true>;
+
+    struct State {
+        /// The upper 16 bits of the tick count
+        volatile uint16_t high;
+        /// The tick count the alarm is set for
+        uint32_t alarmTick;
+        volatile bool alarmArmed;
+        volatile bool alarmFired;
+    };
+
+    /// A static data member of a class that isn't a template would need a definition in exactly one .cpp file, which a header-only
+    /// library can't provide. A static local in an inline function is shared by every file that includes the header instead, so the
+    /// drivers that aren't templates keep their state in a `state()` function like this one.
+    static State& state() {
+        static State s = {};
+        return s;
+    }
+
+    public:
+    /// Start counting from zero, with the overflow interrupt enabled.
+    static void start() {
+        state().high = 0;
+        state().alarmArmed = false;
+        state().alarmFired = false;
+        Timer::disableInterrupt<1>();
+        Timer::disableInterrupt<2>();
+        Timer::init<Config>();
+        Timer::start<Config>();
+    }
+
+    /// Stop the count. Deadlines can't expire while it's stopped.
+    static void stop() {
+        Timer::stop<Config>();
+    }
+
+    /// Returns true if start() has been called (and stop() hasn't).
+    static bool isRunning() {
+        return Timer::isRunning();
+    }
+
+    /// The current tick count.
+    static uint32_t now() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint16_t high = state().high;
+        uint16_t low = Timer::count();
+        if (Timer::overflowFlagSet()) {
+            // The counter has overflowed, but the interrupt hasn't run yet. Read again in case the overflow happened after the first read.
+            low = Timer::count();
+            high++;
+        }
+        __set_interrupt_state(interruptState);
+        return (uint32_t(high) << 16) | low;
+    }
+
+    /// Call this from the TIMER0_B1 interrupt. Returns true when the CPU should wake, because a sleepUntil() may have reached its deadline or the alarm has fired.
+    static bool handleInterrupt() {
+        switch (Timer::pendingInterrupt()) {
+            case 1:
+                return true;
+            case 2:
+                // CCR2 matches the low 16 bits of the alarm once per counter period, so check the whole count
+                if (state().alarmArmed && (int32_t(now() - state().alarmTick) >= 0)) {
+                    Timer::disableInterrupt<2>();
+                    state().alarmArmed = false;
+                    state().alarmFired = true;
+                    return true;
+                }
+                return false;
+            case Timer::overflowInterrupt:
+                state().high++;
+                return false;
+            default:
+                return false;
+        }
+    }
+
+    /// Set the alarm (CCR2) for the tick count `tick`, replacing any alarm already set. When the count reaches it, alarmFired() becomes true
+    /// and handleInterrupt() returns true to wake the CPU. CCR2 can't be set safely less than two ticks ahead, so an alarm that is sooner than that
+    /// (or in the past) fires two ticks from now.
+    static void setAlarm(uint32_t tick) {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint32_t earliest = now() + 2;
+        if (int32_t(tick - earliest) < 0) {
+            tick = earliest;
+        }
+        state().alarmTick = tick;
+        state().alarmArmed = true;
+        Timer::setCompare<2>(uint16_t(tick));
+        Timer::enableInterrupt<2>();
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Cancel the alarm, and clear alarmFired().
+    static void cancelAlarm() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        Timer::disableInterrupt<2>();
+        state().alarmArmed = false;
+        state().alarmFired = false;
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Returns true if the alarm is set and hasn't fired yet.
+    static bool alarmArmed() {
+        return state().alarmArmed;
+    }
+
+    /// The tick count the alarm is set for. Only meaningful while alarmArmed().
+    static uint32_t alarmTick() {
+        return state().alarmTick;
+    }
+
+    /// Returns true if the alarm has fired since the last call to takeAlarm() or cancelAlarm().
+    static bool alarmFired() {
+        return state().alarmFired;
+    }
+
+    /// Returns alarmFired(), and clears it.
+    static bool takeAlarm() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        bool fired = state().alarmFired;
+        state().alarmFired = false;
+        __set_interrupt_state(interruptState);
+        return fired;
+    }
+
+    /// Sleep in the low power mode given by `lpmBits` (e.g. LPM0_bits) until the tick count reaches `tick`.
+    /// CCR1 wakes the CPU at the deadline. Other interrupts may wake it sooner, in which case it goes back to sleep.
+    /// Interrupts are enabled while sleeping, and restored to their previous state afterwards.
+    /// Pick an LPM that keeps running whatever the application needs during the sleep: LPM3 stops SMCLK, and any peripherals clocked from it.
+    static void sleepUntil(uint32_t tick, uint16_t lpmBits = LPM0_bits) {
+        uint16_t interruptState = __get_interrupt_state();
+        while (true) {
+            __disable_interrupt();
+            int32_t remaining = int32_t(tick - now());
+            if (remaining <= 0) {
+                break;
+            }
+            if (remaining < 2) {
+                // Too close to program CCR1 safely: the counter could pass it before the compare is armed
+                __enable_interrupt();
+                continue;
+            }
+            // If the deadline is more than one counter period away, this fires early, and the loop just sleeps again
+            Timer::setCompare<1>(uint16_t(tick));
+            Timer::enableInterrupt<1>();
+            // Enabling interrupts and sleeping in one instruction, so a compare that has already fired still wakes the CPU
+            __bis_SR_register(lpmBits | GIE);
+        }
+        Timer::disableInterrupt<1>();
+        __set_interrupt_state(interruptState);
+    }
+};
+
+/// A point in time, on the Timebase tick count, for bounding waits. Create one with afterMs() or afterUs() and check expired() while waiting.
+/// The deadline is always at least the requested time away. It is at most one tick (~30.5us) more for afterTicks(), and less than 2.5 ticks
+/// (~76us) more for afterMs() and afterUs(), which round up to whole ticks.
+/// ```
+/// Deadline deadline = Deadline::afterMs(50);
+/// while (!dataReady()) {
+///     if (deadline.expired()) {
+///         return timeout;
+///     }
+/// }
+/// ```
+struct Deadline {
+    /// The tick count at which the deadline expires.
+    uint32_t tick;
+
+    /// A deadline `ticks` ticks from now.
+    static Deadline afterTicks(uint32_t ticks) {
+        // The current tick is already partly over, so add one to guarantee the full length. The wait is then between `ticks` and `ticks` + 1.
+        return {Timebase::now() + ticks + 1};
+    }
+
+    /// A deadline `ms` milliseconds from now.
+    static Deadline afterMs(uint16_t ms) {
+        // ms * 32768 / 1000 = ms * 32.768, as ms * 32 + ms * 50332 / 65536 to avoid a runtime division. Rounded up, so it's never short:
+        // 50332 / 65536 is slightly more than 0.768, which adds at most 0.35 ticks at 65535ms.
+        return afterTicks((uint32_t(ms) << 5) + ((uint32_t(ms) * 50332 + 65535) >> 16));
+    }
+
+    /// A deadline `us` microseconds from now.
+    static Deadline afterUs(uint16_t us) {
+        // us * 32768 / 1000000 = us * 0.032768, as us * 34360 / 2^20 to avoid a runtime division. Rounded up, so it's never short:
+        // 34360 / 2^20 is slightly more than 0.032768, which adds at most 0.02 ticks at 65535us.
+        return afterTicks((uint32_t(us) * 34360 + ((uint32_t(1) << 20) - 1)) >> 20);
+    }
+
+    /// Returns true once the deadline has passed.
+    bool expired() const {
+        return int32_t(Timebase::now() - tick) >= 0;
+    }
+
+    /// Number of ticks until the deadline, or 0 if it has passed.
+    uint32_t remainingTicks() const {
+        int32_t remaining = int32_t(tick - Timebase::now());
+        return (remaining > 0) ? uint32_t(remaining) : 0;
+    }
+
+    /// Sleep in the low power mode given by `lpmBits` until the deadline. See Timebase::sleepUntil().
+    void sleep(uint16_t lpmBits = LPM0_bits) const {
+        Timebase::sleepUntil(tick, lpmBits);
+    }
+};
+
+/// Delays of at least this many milliseconds sleep in LPM0 on the Timebase (when it is running, and interrupts are enabled) rather than busy-waiting.
+constexpr uint32_t delaySleepThresholdMs = 2;
+
+/// Busy-wait for `Us` microseconds at MCLK = `MclkHz`. The cycle count is calculated at compile time, so the delay is exact
+/// to within the few cycles of the surrounding code. The delay is only correct while MCLK actually runs at `MclkHz`.
+template<uint32_t Us, uint32_t MclkHz = HAL_MCLK_HZ>
+inline void delayUs() {
+    static_assert(uint64_t(MclkHz) * Us / 1000000 <= 0xFFFFFFFF, "Delay too long. Use delayMs() instead.");
+    detail::delayCycles<detail::cyclesForUs(MclkHz, Us)>();
+}
+
+/// Busy-wait for `Us` microseconds at the MCLK frequency of `Clock`, a ClockConfig<...>.
+template<uint32_t Us, typename Clock>
+inline void delayUs() {
+    delayUs<Us, Clock::mclkHz>();
+}
+
+/// Wait for `Ms` milliseconds at MCLK = `MclkHz`.
+/// Delays of delaySleepThresholdMs or more sleep in LPM0 if the Timebase is running, which is accurate to one tick (~30.5us) and
+/// uses far less power. Sleeping needs interrupts, so inside a critical section or an interrupt handler (where GIE is clear) the delay
+/// busy-waits instead, and never enables interrupts behind the caller's back. Otherwise the delay busy-waits for a number of cycles
+/// calculated at compile time.
+template<uint32_t Ms, uint32_t MclkHz = HAL_MCLK_HZ>
+inline void delayMs() {
+    static_assert(uint64_t(MclkHz) * Ms / 1000 <= 0xFFFFFFFF, "Delay too long to busy-wait for at this MCLK frequency");
+    if ((Ms >= delaySleepThresholdMs) && (__get_interrupt_state() & GIE) && Timebase::isRunning()) {
+        Timebase::sleepUntil(Timebase::now() + Timebase::ticksForMs(Ms) + 1);
+    } else {
+        detail::delayCycles<detail::cyclesForMs(MclkHz, Ms)>();
+    }
+}
+
+/// Wait for `Ms` milliseconds at the MCLK frequency of `Clock`, a ClockConfig<...>.
+template<uint32_t Ms, typename Clock>
+inline void delayMs() {
+    delayMs<Ms, Clock::mclkHz>();
+}
+
+#endif /* DELAY_HPP */
@@ -2,6 +2,7 @@
 #define EUSCI_HPP
 
 #include <msp430.h>
+#include <stdint.h>
 
 // Options common to more than one EUSCI protocol (UART / SPI / I2C)
 
@@ -20,4 +21,10 @@ enum ClockSource {
     Smclk = UCSSEL__SMCLK,
 };
 
+/// The SPI or I2C clock prescaler (UCBRW) that gives the fastest bit rate not above `bitRateHz`, from a `clockHz` source clock.
+/// With a ClockConfig this is evaluated at compile time, e.g. `eusciPrescaler(SystemClock::smclkHz, 400000)`.
+constexpr uint16_t eusciPrescaler(uint32_t clockHz, uint32_t bitRateHz) {
+    return (clockHz <= bitRateHz) ? 1 : uint16_t((clockHz + bitRateHz - 1) / bitRateHz);
+}
+
 #endif
@@ -0,0 +1,235 @@
+#ifndef FILTERS_HPP
+#define FILTERS_HPP
+
+#include <stdint.h>
+#include <limits>
+#include <type_traits>
+
+// Fixed-point filters for streams of samples, e.g. ADC results. Each filter is a small object holding its own history,
+// with an update() function that takes one new sample and returns the filtered value. The sizes and coefficients are template
+// parameters, so divisions become shifts and coefficients become immediate operands.
+
+// Internal implementation details
+namespace detail {
+    constexpr bool isPowerOfTwo(uint32_t n) {
+        return (n != 0) && ((n & (n - 1)) == 0);
+    }
+
+    constexpr uint8_t log2(uint32_t n) {
+        return (n <= 1) ? 0 : 1 + log2(n >> 1);
+    }
+
+    template<typename T, typename Acc>
+    constexpr T saturate(Acc value, T min, T max) {
+        return (value > max) ? max : (value < min) ? min : T(value);
+    }
+
+    constexpr uint64_t magnitude(int64_t value) {
+        return (value < 0) ? uint64_t(-value) : uint64_t(value);
+    }
+}
+
+/// A signed fixed-point number format with `FracBits` fractional bits, stored in `T` and multiplied in `Acc`.
+template<typename T, typename Acc, uint8_t FracBits, T Min, T Max>
+struct QFormat {
+    using Type = T;
+    using Accumulator = Acc;
+    static constexpr uint8_t fracBits = FracBits;
+    static constexpr T min = Min;
+    static constexpr T max = Max;
+
+    /// Convert a real number to this format at compile time, e.g. `Q15::from(0.25)`. Values out of range are saturated.
+    static constexpr T from(double value) {
+        return (value * double(Acc(1) << FracBits) >= double(Max)) ? Max :
+               (value * double(Acc(1) << FracBits) <= double(Min)) ? Min :
+               T(value * double(Acc(1) << FracBits) + ((value < 0) ? -0.5 : 0.5));
+    }
+};
+
+template<typename T, typename Acc, uint8_t FracBits, T Min, T Max>
+constexpr T QFormat<T, Acc, FracBits, Min, Max>::min;
+
+template<typename T, typename Acc, uint8_t FracBits, T Min, T Max>
+constexpr T QFormat<T, Acc, FracBits, Min, Max>::max;
+
+/// 16-bit fixed point, range -1 to just under 1.
+using Q15 = QFormat<int16_t, int32_t, 15, INT16_MIN, INT16_MAX>;
+/// 32-bit fixed point, range -1 to just under 1.
+using Q31 = QFormat<int32_t, int64_t, 31, INT32_MIN, INT32_MAX>;
+
+/// Average of the last `Length` samples. `Length` must be a power of two so the division is a shift.
+/// Each update is one add, one subtract, and one shift, however long the window is.
+template<uint16_t Length, typename T = uint16_t>
+struct BoxcarFilter {
+    static_assert(detail::isPowerOfTwo(Length), "Length must be a power of two");
+
+    T history[Length] = {};
+    uint16_t index = 0;
+    int32_t sum = 0;
+
+    T update(T sample) {
+        sum += int32_t(sample) - int32_t(history[index]);
+        history[index] = sample;
+        index = (index + 1) & (Length - 1);
+        return T(sum >> detail::log2(Length));
+    }
+};
+
+/// Exponential moving average: y += (x - y) / 2^Shift. A larger `Shift` gives heavier smoothing, with a time constant of about 2^Shift samples.
+/// The average is kept with `Shift` extra fractional bits so small changes aren't lost to rounding. No multiplies are needed.
+template<uint8_t Shift, typename T = uint16_t>
+struct EmaFilter {
+    static_assert(Shift >= 1 && Shift <= 15, "Shift must be between 1 and 15");
+
+    int32_t scaled = 0;
+
+    /// Start the average at `value` instead of 0, to skip the initial settling.
+    void reset(T value) {
+        scaled = int32_t(value) << Shift;
+    }
+
+    T update(T sample) {
+        scaled += int32_t(sample) - (scaled >> Shift);
+        return T(scaled >> Shift);
+    }
+};
+
+/// Second order IIR section (direct form I): y = b0*x0 + b1*x1 + b2*x2 - a1*y1 - a2*y2.
+/// Samples are in `Format` (Q15 or Q31). Coefficients are given in the same type but with one fewer fractional bit (i.e. Q14 or Q30),
+/// so that they can reach +-2 as biquad coefficients usually need to; build them with Biquad::coeff(). a0 is assumed to be 1.
+/// ```
+/// // 2nd order Butterworth low pass at 1/10 of the sample rate
+/// using Lowpass = Biquad<Q15,
+///     Biquad<Q15>::coeff(0.0675), Biquad<Q15>::coeff(0.1349), Biquad<Q15>::coeff(0.0675),
+///     Biquad<Q15>::coeff(-1.1430), Biquad<Q15>::coeff(0.4128)>;
+/// ```
+/// ADC counts can be fed in directly as they fit within Q15 without scaling. Cascade several sections for higher order filters.
+///
+/// The five products are summed before the result is saturated, so the sum must not overflow the accumulator. It can't as long as
+/// |b0| + |b1| + |b2| + |a1| + |a2| < 4, which holds for most low and high pass sections. Sharper (high Q or high gain) sections can exceed it:
+/// Q15 sections then accumulate in 64 bits instead of 32, which is chosen at compile time and costs more cycles per sample.
+/// Q31 has no wider accumulator, so such sections are rejected at compile time: reduce the gain, or split it across sections.
+template<typename Format,
+    typename Format::Type B0 = 0, typename Format::Type B1 = 0, typename Format::Type B2 = 0,
+    typename Format::Type A1 = 0, typename Format::Type A2 = 0>
+struct Biquad {
+    using T = typename Format::Type;
+    static constexpr uint8_t coeffFracBits = Format::fracBits - 1;
+
+    private:
+    /// Sum of the coefficient magnitudes, in the coefficient format. The largest possible sum of products is this times the largest sample, 2^fracBits.
+    static constexpr uint64_t coeffSum = detail::magnitude(B0) + detail::magnitude(B1) + detail::magnitude(B2) + detail::magnitude(A1) + detail::magnitude(A2);
+    static constexpr bool fitsFormatAccumulator =
+        coeffSum <= ((uint64_t(std::numeric_limits<typename Format::Accumulator>::max()) - (uint64_t(1) << (coeffFracBits - 1))) >> Format::fracBits);
+
+    static_assert(fitsFormatAccumulator || (sizeof(typename Format::Accumulator) < sizeof(int64_t)),
+        "The coefficients are too large for the accumulator: |b0| + |b1| + |b2| + |a1| + |a2| must be less than 4");
+
+    public:
+    /// The accumulator the products are summed in: the format's own, unless the coefficients are large enough to overflow it.
+    using Acc = typename std::conditional<fitsFormatAccumulator, typename Format::Accumulator, int64_t>::type;
+
+    /// Convert a real coefficient to the coefficient format at compile time.
+    static constexpr T coeff(double value) {
+        return (value * double(Acc(1) << coeffFracBits) >= double(Format::max)) ? Format::max :
+               (value * double(Acc(1) << coeffFracBits) <= double(Format::min)) ? Format::min :
+               T(value * double(Acc(1) << coeffFracBits) + ((value < 0) ? -0.5 : 0.5));
+    }
+
+    T x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+    T update(T x0) {
+        Acc acc = Acc(B0) * x0 + Acc(B1) * x1 + Acc(B2) * x2 - Acc(A1) * y1 - Acc(A2) * y2;
+        // Round, then saturate so an overflow clips instead of wrapping around
+        T y0 = detail::saturate<T, Acc>((acc + (Acc(1) << (coeffFracBits - 1))) >> coeffFracBits, Format::min, Format::max);
+        x2 = x1;
+        x1 = x0;
+        y2 = y1;
+        y1 = y0;
+        return y0;
+    }
+};
+
+/// Median of the last `Length` samples, which removes spikes and impulse noise without smearing steps like an average does.
+/// Each update is O(Length): the oldest sample is removed from a sorted copy of the window and the new one inserted.
+template<uint8_t Length, typename T = uint16_t>
+struct MedianFilter {
+    static_assert(Length % 2 == 1, "Length must be odd so there is a single middle sample");
+    static_assert(Length >= 3, "Length must be at least 3");
+
+    /// Samples in arrival order
+    T history[Length] = {};
+    /// The same samples in ascending order
+    T sorted[Length] = {};
+    uint8_t index = 0;
+
+    T update(T sample) {
+        T oldest = history[index];
+        history[index] = sample;
+        index = (index + 1 == Length) ? 0 : index + 1;
+
+        // Find the oldest sample in the sorted window
+        uint8_t pos = 0;
+        while (sorted[pos] != oldest) {
+            pos++;
+        }
+        // Shift it out in the direction of the new sample, then drop the new sample into the gap
+        while ((pos > 0) && (sorted[pos - 1] > sample)) {
+            sorted[pos] = sorted[pos - 1];
+            pos--;
+        }
+        while ((pos < Length - 1) && (sorted[pos + 1] < sample)) {
+            sorted[pos] = sorted[pos + 1];
+            pos++;
+        }
+        sorted[pos] = sample;
+        return sorted[Length / 2];
+    }
+};
+
+/// Cascaded integrator-comb decimator: an `Order` stage moving-average filter that outputs one sample for every `Rate` inputs, using only adds and subtracts.
+/// The result is scaled back to the input range by a shift, so `Rate` must be a power of two. Use this to reduce a fast ADC stream
+/// before further (more expensive) filtering. The internal registers wrap around, which is expected and doesn't affect the output.
+template<uint8_t Order, uint16_t Rate>
+struct CicDecimator {
+    static_assert(Order >= 1 && Order <= 4, "Order must be between 1 and 4");
+    static_assert(detail::isPowerOfTwo(Rate) && Rate >= 2, "Rate must be a power of two");
+    /// Number of bits the filter's gain adds. Together with the 16-bit input this must fit in the 32-bit registers.
+    static constexpr uint8_t gainBits = Order * detail::log2(Rate);
+    static_assert(gainBits <= 16, "Order * log2(Rate) must be at most 16");
+
+    uint32_t integrator[Order] = {};
+    uint32_t comb[Order] = {};
+    uint16_t countdown = Rate;
+    uint16_t result = 0;
+
+    /// Add one sample. Returns true when a new output is available from output().
+    bool update(uint16_t sample) {
+        uint32_t value = sample;
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < Order; i++) {
+            integrator[i] += value;
+            value = integrator[i];
+        }
+        if (--countdown != 0) {
+            return false;
+        }
+        countdown = Rate;
+
+        for (uint8_t i = 0; i < Order; i++) {
+            uint32_t delayed = comb[i];
+            comb[i] = value;
+            value -= delayed;
+        }
+        #pragma diag_default 1544
+        result = uint16_t(value >> gainBits);
+        return true;
+    }
+
+    /// The most recent output, in the same range as the input.
+    uint16_t output() const {
+        return result;
+    }
+};
+
+#endif /* FILTERS_HPP */
@@ -0,0 +1,206 @@
+#ifndef FLL_RELOCK_HPP
+#define FLL_RELOCK_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "clock.hpp"
+
+/// Statistics from one FllRelock frequency change.
+///
+/// Nothing here is a measured frequency error. Once locked, the FLL holds the average DCO frequency at (FLLN + 1) times the reference, so
+/// the average error is the reference's own. What the trim changes is where the DCO sits in its tap range: tapErrorBefore and
+/// tapErrorAfter are the distances of DCOTAP from the centre tap, which stand in for how far the FLL has to pull the DCO, and so how much
+/// it wanders from cycle to cycle. To measure the actual frequency, output SMCLK on a pin and count it with a GatedCounter gated from
+/// an interrupt that runs from the reference (e.g. the RTC).
+struct FllLockReport {
+    /// Number of poll() calls from start() until the FLL locked with the final trim. Multiply by the poll period for the lock time.
+    uint16_t lockTicks;
+    /// Number of DCOFTRIM values tried.
+    uint8_t trials;
+    /// The DCOFTRIM value chosen.
+    uint8_t trim;
+    /// DCOTAP - 256 after the first lock, with the default trim, in taps rather than Hz or ppm. The further this is from 0, the closer the
+    /// DCO is to the edge of its tap range, and the more its frequency wanders as the FLL corrects it.
+    int16_t tapErrorBefore;
+    /// DCOTAP - 256 after trimming, in taps.
+    int16_t tapErrorAfter;
+};
+
+/// Changes the DCO frequency without blocking, and trims the DCO with DCOFTRIM so the FLL locks near the middle of its tap range
+/// (TI's recommended 'software trim' procedure, see the CS code examples for the MSP430FR235x).
+/// Each step of the procedure is run by poll(), so the application keeps running while the FLL settles.
+/// The DCO is the only fast clock, so MCLK and SMCLK follow it during the change rather than staying at the old frequency:
+/// avoid timing-critical peripheral activity until the lock is reported.
+///
+/// Call poll() regularly, ideally from a periodic interrupt that doesn't depend on the DCO (e.g. the watchdog in timer mode, sourced from ACLK).
+/// After each trim change the FLL needs about 24 reference clock cycles (~0.75ms) before its lock status can be trusted,
+/// so `SettleTicks` should be at least that long in poll() calls. lockTicks in the report is measured in the same calls.
+/// ```
+/// FllRelock<1>::start<ClockConfig<16000000>>(onLocked);
+/// // In a 1ms watchdog interval interrupt:
+/// if (FllRelock<1>::poll()) {
+///     __bic_SR_register_on_exit(LPM0_bits); // Locked at the new frequency
+/// }
+/// ```
+template<uint8_t SettleTicks = 1>
+struct FllRelock {
+    static_assert(SettleTicks >= 1, "SettleTicks must be at least 1");
+
+    private:
+    enum class Step : uint8_t {
+        Idle,
+        /// Waiting for the FLL lock status to become meaningful after a trim change
+        Settling,
+        /// Waiting for the FLL to lock with the trim being tried
+        Trialling,
+        /// Waiting for the FLL to lock with the best trim
+        Finishing,
+    };
+
+    struct State {
+        volatile Step step;
+        uint8_t countdown;
+        uint16_t oldTap;
+        uint16_t bestDelta;
+        uint16_t bestCtl0;
+        uint16_t bestCtl1;
+        void (*finishChange)();
+        void (*onLocked)(const FllLockReport&);
+        FllLockReport report;
+    };
+    static State s;
+
+    static constexpr uint16_t centreTap = 256;
+
+    /// Restart the FLL from the centre tap with the current trim, and wait for it to settle.
+    static void beginTrial() {
+        CSCTL0 = centreTap;
+        do {
+            CSCTL7 &= ~DCOFFG;
+        } while (CSCTL7 & DCOFFG);
+        s.report.trials++;
+        s.countdown = SettleTicks;
+        s.step = Step::Settling;
+    }
+
+    static bool fllUnlocked() {
+        return CSCTL7 & (FLLUNLOCK0 | FLLUNLOCK1);
+    }
+
+    /// Examine the tap the FLL locked to, and either try the next trim value or settle on the best one found.
+    static void evaluateTrial() {
+        uint16_t ctl0 = CSCTL0;
+        uint16_t ctl1 = CSCTL1;
+        uint16_t tap = ctl0 & DCO;
+        uint8_t trim = (ctl1 & DCOFTRIM) >> 4;
+        bool first = (s.report.trials == 1);
+        if (first) {
+            s.report.tapErrorBefore = int16_t(tap) - int16_t(centreTap);
+        }
+
+        // A higher trim speeds up the DCO, so the FLL needs a lower tap. Step the trim until the tap crosses the centre.
+        uint16_t delta;
+        bool crossed;
+        int8_t direction;
+        if (tap < centreTap) {
+            delta = centreTap - tap;
+            crossed = !first && (s.oldTap >= centreTap);
+            direction = -1;
+        } else {
+            delta = tap - centreTap;
+            crossed = !first && (s.oldTap < centreTap);
+            direction = 1;
+        }
+        s.oldTap = tap;
+
+        if (delta < s.bestDelta) {
+            s.bestDelta = delta;
+            s.bestCtl0 = ctl0;
+            s.bestCtl1 = ctl1;
+        }
+
+        // Stop at the edges of the trim range as well, where the next step would wrap around
+        bool atLimit = (direction < 0) ? (trim == 0) : (trim == 7);
+        if (crossed || atLimit) {
+            CSCTL0 = s.bestCtl0;
+            CSCTL1 = s.bestCtl1;
+            s.step = Step::Finishing;
+        } else {
+            CSCTL1 = (ctl1 & ~DCOFTRIM) | (uint16_t(trim + direction) << 4);
+            beginTrial();
+        }
+    }
+
+    public:
+    /// Begin switching to the clock configuration `Config` (a ClockConfig<...>). Returns immediately.
+    /// `onLocked` (optional) is called from poll() once the FLL has locked at the new frequency.
+    template<typename Config>
+    static void start(void (*onLocked)(const FllLockReport&) = nullptr) {
+        s.step = Step::Idle;
+        s.report = {};
+        s.oldTap = 0;
+        s.bestDelta = 0xFFFF;
+        s.finishChange = &Config::finishChange;
+        s.onLocked = onLocked;
+
+        Config::beginChange();
+        // Start trimming from the middle of the range
+        CSCTL1 = (CSCTL1 & ~DCOFTRIM) | DCOFTRIMEN | DCOFTRIM0 | DCOFTRIM1;
+        beginTrial();
+    }
+
+    /// Advance the frequency change. Returns true on the call where the FLL locks at the new frequency.
+    static bool poll() {
+        if (s.step == Step::Idle) {
+            return false;
+        }
+        s.report.lockTicks++;
+
+        switch (s.step) {
+            case Step::Settling:
+                if (--s.countdown == 0) {
+                    s.step = Step::Trialling;
+                }
+                return false;
+            case Step::Trialling:
+                // A DCO fault means the tap hit the end of its range, which is still a result worth evaluating
+                if (fllUnlocked() && !(CSCTL7 & DCOFFG)) {
+                    return false;
+                }
+                evaluateTrial();
+                return false;
+            case Step::Finishing:
+                if (fllUnlocked()) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+        }
+
+        s.step = Step::Idle;
+        s.report.trim = (CSCTL1 & DCOFTRIM) >> 4;
+        s.report.tapErrorAfter = int16_t(CSCTL0 & DCO) - int16_t(centreTap);
+        s.finishChange();
+        if (s.onLocked) {
+            s.onLocked(s.report);
+        }
+        return true;
+    }
+
+    /// Returns true while a frequency change is in progress.
+    static bool isBusy() {
+        return s.step != Step::Idle;
+    }
+
+    /// Statistics from the most recent frequency change. Only complete once isBusy() returns false.
+    static const FllLockReport& report() {
+        return s.report;
+    }
+};
+
+template<uint8_t SettleTicks>
+typename FllRelock<SettleTicks>::State FllRelock<SettleTicks>::s;
+
+#endif /* FLL_RELOCK_HPP */
@@ -0,0 +1,36 @@
+#ifndef FRAM_HPP
+#define FRAM_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+/// Lifts the program FRAM write protection (SYSCFG0.PFWP) for as long as it exists, so variables declared with `#pragma PERSISTENT`
+/// (which the linker places in program FRAM, alongside the code) can be written. The previous protection is restored on destruction,
+/// so guards can nest, and can be used from interrupts. Keep the scope as short as possible: while it exists, a stray write can corrupt the program.
+/// ```
+/// #pragma PERSISTENT(bootCount)
+/// static uint16_t bootCount = 0;
+/// ...
+/// {
+///     FramWriteEnable unlock;
+///     bootCount++;
+/// }
+/// ```
+class FramWriteEnable {
+    uint8_t saved;
+
+    public:
+    FramWriteEnable() : saved(SYSCFG0_L) {
+        // The password must be written with every change, and reads back as something else, so only the low byte is kept
+        SYSCFG0 = FRWPPW | (saved & ~PFWP);
+    }
+
+    ~FramWriteEnable() {
+        SYSCFG0 = FRWPPW | saved;
+    }
+
+    FramWriteEnable(const FramWriteEnable&) = delete;
+    FramWriteEnable& operator=(const FramWriteEnable&) = delete;
+};
+
+#endif /* FRAM_HPP */
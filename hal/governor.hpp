@@ -0,0 +1,216 @@
+#ifndef GOVERNOR_HPP
+#define GOVERNOR_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+#include <initializer_list>
+
+#include "clock.hpp"
+#include "eusci.hpp"
+#include "blocking_uart.hpp"
+
+/// The list of ClockConfigs a Governor can switch between, slowest first, e.g.
+/// `PerformanceLevels<ClockConfig<1048576>, ClockConfig<8000000>, ClockConfig<24000000>>`.
+template<typename... Levels>
+struct PerformanceLevels {};
+
+/// Keeps a UART at `Baud` across Governor level changes. The baud settings for every level are calculated at compile time.
+template<typename Uart, uint32_t Baud>
+struct RetuneBaud {
+    template<typename Clock>
+    static void retune() {
+        constexpr BaudConfig baud = BaudConfig::calculate(Clock::smclkHz, Baud);
+        Uart::setBaud(baud);
+    }
+};
+
+/// Keeps an SPI or I2C master at (at most) `BitRate` across Governor level changes. The prescaler for every level is calculated at compile time.
+template<typename Peripheral, uint32_t BitRate>
+struct RetunePrescaler {
+    template<typename Clock>
+    static void retune() {
+        constexpr uint16_t prescaler = eusciPrescaler(Clock::smclkHz, BitRate);
+        Peripheral::setPrescaler(prescaler);
+    }
+};
+
+// Internal implementation details
+namespace detail {
+    constexpr bool isAscending(std::initializer_list<uint32_t> values) {
+        uint32_t last = 0;
+        for (uint32_t value : values) {
+            if (value <= last) {
+                return false;
+            }
+            last = value;
+        }
+        return true;
+    }
+}
+
+template<typename Levels, typename... Dependents>
+struct Governor;
+
+/// Switches the clock system between a fixed set of performance levels, e.g. to idle at 1MHz and burst at 24MHz.
+/// Every level is a ClockConfig, so the register values for every level are calculated at compile time. On each change the FRAM wait states
+/// are added before the clock speeds up and removed after it slows down, and every `Dependents` peripheral (RetuneBaud or RetunePrescaler)
+/// is reprogrammed for the new SMCLK frequency.
+/// ```
+/// using Levels = PerformanceLevels<ClockConfig<1048576>, ClockConfig<8000000>, ClockConfig<24000000>>;
+/// Governor<Levels, RetuneBaud<Uart<UART_A1>, 115200>> governor;
+/// ```
+///
+/// The governor starts at level 0, so call setLevel() during startup (which also initialises the clocks and dependent peripherals).
+/// The level can be set directly with setLevel(), or chosen automatically from the CPU load. For the latter:
+/// - Enter low power modes with sleep(), so the governor knows when the CPU is idle.
+/// - Call tick() from a periodic interrupt that doesn't depend on the clock being changed (e.g. the watchdog in timer mode, sourced from ACLK).
+///   Each tick samples whether the CPU was busy, and at the end of each window of samples a new level is requested if the load was too high or low.
+/// - Call update() from the main loop to carry out the requested change. Changes wait for the FLL to lock, so they aren't made from the interrupt.
+template<typename... Levels, typename... Dependents>
+struct Governor<PerformanceLevels<Levels...>, Dependents...> {
+    /// Number of performance levels.
+    static constexpr uint8_t levelCount = sizeof...(Levels);
+
+    static_assert(levelCount > 0, "Governor needs at least one performance level");
+    static_assert(detail::isAscending({Levels::mclkHz...}), "Performance levels must be in order of increasing MCLK frequency");
+
+    private:
+    struct State {
+        volatile uint8_t level;
+        volatile int8_t requested;
+        /// True while the CPU is in a low power mode entered through sleep()
+        volatile bool idle;
+        uint16_t windowTicks;
+        uint8_t upPercent;
+        uint8_t downPercent;
+        uint16_t samples;
+        uint16_t busySamples;
+        volatile uint8_t lastLoadPercent;
+        volatile uint32_t residency[levelCount];
+        uint16_t transitions;
+    };
+    static State s;
+
+    template<typename Clock>
+    static void applyLevel() {
+        Clock::apply();
+        using expand = int[];
+        (void)expand{0, (Dependents::template retune<Clock>(), 0)...};
+    }
+
+    public:
+    /// Set the automatic policy: every `windowTicks` ticks, a higher level is requested if the CPU was busy for at least `upPercent` of the window,
+    /// and a lower level if it was busy for at most `downPercent`.
+    static void configure(uint16_t windowTicks, uint8_t upPercent = 75, uint8_t downPercent = 25) {
+        s.windowTicks = windowTicks;
+        s.upPercent = upPercent;
+        s.downPercent = downPercent;
+        s.samples = 0;
+        s.busySamples = 0;
+    }
+
+    /// Switch to performance level `level` (an index into Levels) now, waiting for the FLL to lock.
+    /// Peripherals are reprogrammed afterwards, so avoid changing level in the middle of a transfer.
+    static void setLevel(uint8_t level) {
+        static void (* const apply[])() = {&applyLevel<Levels>...};
+        if (level >= levelCount) {
+            level = levelCount - 1;
+        }
+        apply[level]();
+        s.level = level;
+        s.requested = -1;
+        s.transitions++;
+    }
+
+    /// The current performance level.
+    static uint8_t level() {
+        return s.level;
+    }
+
+    /// Carry out a level change requested by tick(). Returns true if the level changed.
+    static bool update() {
+        int8_t requested = s.requested;
+        if (requested < 0) {
+            return false;
+        }
+        setLevel(requested);
+        return true;
+    }
+
+    /// Enter the low power mode given by `lpmBits` (e.g. LPM0_bits) with interrupts enabled, and mark the CPU as idle until it wakes.
+    static void sleep(uint16_t lpmBits) {
+        s.idle = true;
+        __bis_SR_register(lpmBits | GIE);
+        s.idle = false;
+    }
+
+    /// Call this from a periodic interrupt. Samples the CPU load, counts residency, and requests level changes at the end of each window.
+    /// Returns true if a level change has been requested, so the interrupt can wake the CPU to call update().
+    static bool tick() {
+        s.residency[s.level]++;
+        if (s.windowTicks == 0) {
+            return false;
+        }
+        s.samples++;
+        if (!s.idle) {
+            s.busySamples++;
+        }
+        if (s.samples < s.windowTicks) {
+            return false;
+        }
+
+        uint32_t busy = uint32_t(s.busySamples) * 100;
+        s.lastLoadPercent = uint8_t(busy / s.samples);
+        bool raise = busy >= uint32_t(s.upPercent) * s.samples;
+        bool lower = busy <= uint32_t(s.downPercent) * s.samples;
+        s.samples = 0;
+        s.busySamples = 0;
+
+        if (raise && (s.level + 1 < levelCount)) {
+            s.requested = s.level + 1;
+            return true;
+        }
+        if (lower && (s.level > 0)) {
+            s.requested = s.level - 1;
+            return true;
+        }
+        return false;
+    }
+
+    /// Percentage of the last complete window that the CPU was busy.
+    static uint8_t load() {
+        return s.lastLoadPercent;
+    }
+
+    /// Number of ticks spent at level `level` since reset, or since resetStats().
+    static uint32_t residency(uint8_t level) {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint32_t ticks = s.residency[level];
+        __set_interrupt_state(interruptState);
+        return ticks;
+    }
+
+    /// Number of level changes since reset, or since resetStats().
+    static uint16_t transitions() {
+        return s.transitions;
+    }
+
+    /// Clear the residency and transition statistics.
+    static void resetStats() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < levelCount; i++) {
+            s.residency[i] = 0;
+        }
+        #pragma diag_default 1544
+        s.transitions = 0;
+        __set_interrupt_state(interruptState);
+    }
+};
+
+template<typename... Levels, typename... Dependents>
+typename Governor<PerformanceLevels<Levels...>, Dependents...>::State Governor<PerformanceLevels<Levels...>, Dependents...>::s = {0, -1};
+
+#endif /* GOVERNOR_HPP */
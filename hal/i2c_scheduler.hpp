@@ -0,0 +1,352 @@
+#ifndef I2C_SCHEDULER_HPP
+#define I2C_SCHEDULER_HPP
+
+#include <stdint.h>
+#include <msp430.h>
+
+#include "util.hpp"
+
+/// Timing statistics for a single I2cPollJob. All times are measured in scheduler ticks.
+struct I2cPollStats {
+    /// Number of polls that completed successfully.
+    uint16_t completed;
+    /// Number of polls that were NACKed.
+    uint16_t failed;
+    /// Number of polls that lost arbitration to another master and had to be retried (multi-master mode only).
+    uint16_t arbitrationLosses;
+    /// Number of times the job became due while the previous poll was still waiting or in progress.
+    /// If this is increasing the bus is oversubscribed.
+    uint16_t overruns;
+    /// Ticks between the job becoming due and the poll starting, for the most recent poll.
+    uint16_t lastLatency;
+    /// Largest latency seen so far.
+    uint16_t maxLatency;
+    /// Smallest number of ticks between two consecutive polls starting.
+    uint16_t minInterval;
+    /// Largest number of ticks between two consecutive polls starting.
+    uint16_t maxInterval;
+
+    /// Difference between the longest and shortest interval between polls.
+    uint16_t jitter() const {
+        return maxInterval - minInterval;
+    }
+};
+
+/// A periodic poll of one I2C device: | S | addr+W | writeData... | R | addr+R | ->result... | P |
+/// If writeLen is zero the write is skipped, and the poll is just a read. If both are zero, the poll is an address-only probe:
+/// | S | addr+W | P |, which completes if the device ACKs its address and fails if it doesn't.
+/// `buffers` must point to 2*readLen bytes. Results are double-buffered so a consistent snapshot can always be read.
+/// Only the first six fields need to be filled in, the remainder are used internally by the scheduler and should be left zero.
+struct I2cPollJob {
+    uint16_t address;
+    const uint8_t* writeData;
+    uint8_t writeLen;
+    uint8_t readLen;
+    /// How often to poll, in scheduler ticks.
+    uint16_t period;
+    uint8_t* buffers;
+
+    // Internal state
+    volatile uint8_t front;
+    volatile uint16_t sequence;
+    uint16_t countdown;
+    uint16_t dueTick;
+    uint16_t lastStartTick;
+    bool pending;
+    I2cPollStats stats;
+};
+
+/// Runs a set of periodic I2C polls back-to-back on one bus, entirely from interrupts.
+/// Takes the same register parameters as I2cMaster, e.g. `I2cScheduler<I2C_B0>`.
+///
+/// The peripheral must first be initialised with I2cMaster::init(). Don't use the blocking I2cMaster functions on the same bus while the scheduler is running.
+/// Two interrupts must be forwarded to the scheduler:
+/// - tick() from a periodic timer interrupt (e.g. the watchdog in timer mode). This sets the time base for job periods.
+/// - handleInterrupt() from the eUSCI_B interrupt for this bus.
+template<
+    volatile uint16_t* CTLW0,
+    volatile uint16_t* CTLW1,
+    volatile uint16_t* BRW,
+    volatile uint16_t* STATW,
+    volatile uint16_t* RXBUF,
+    volatile uint16_t* TXBUF,
+    volatile uint16_t* SA,
+    volatile uint16_t* IE,
+    volatile uint16_t* IFG,
+    volatile uint16_t* IV
+>
+struct I2cScheduler {
+    private:
+    struct State {
+        I2cPollJob* jobs;
+        uint8_t jobCount;
+        /// Index of the job currently using the bus, or -1 if the bus is idle.
+        int8_t active;
+        /// Job to check first when looking for the next pending job, so every job gets a fair turn.
+        uint8_t next;
+        /// Number of bytes written or read so far in the current phase of the active job.
+        uint8_t index;
+        bool failed;
+        /// Set when arbitration was lost. The peripheral is in slave mode until the other master releases the bus.
+        bool lostArbitration;
+        volatile uint16_t now;
+    };
+    static State s;
+
+    static uint8_t* backBuffer(I2cPollJob& job) {
+        return job.buffers + ((job.front ^ 1) * job.readLen);
+    }
+
+    static void beginRead(I2cPollJob& job) {
+        s.index = 0;
+        CLEAR_BITS(CTLW0, UCTR);
+        if (job.readLen == 1) {
+            // A single byte read must schedule the stop as soon as the address has been sent, before the byte is received.
+            // The 9th bit interrupt fires on the address ACK, so the stop is set from there rather than by waiting here.
+            // The flag is also set by every byte before this, so clear it first
+            CLEAR_BITS(IFG, UCBIT9IFG);
+            SET_BITS(IE, UCBIT9IE);
+        }
+        SET_BITS(CTLW0, UCTXSTT);
+    }
+
+    static void startJob(uint8_t i) {
+        I2cPollJob& job = s.jobs[i];
+        job.pending = false;
+
+        // Latency and interval statistics
+        uint16_t latency = s.now - job.dueTick;
+        job.stats.lastLatency = latency;
+        if (latency > job.stats.maxLatency) {
+            job.stats.maxLatency = latency;
+        }
+        if (job.stats.completed + job.stats.failed > 0) {
+            uint16_t interval = s.now - job.lastStartTick;
+            if (interval < job.stats.minInterval) {
+                job.stats.minInterval = interval;
+            }
+            if (interval > job.stats.maxInterval) {
+                job.stats.maxInterval = interval;
+            }
+        }
+        job.lastStartTick = s.now;
+
+        s.active = i;
+        s.index = 0;
+        s.failed = false;
+        *SA = job.address;
+        if ((job.writeLen > 0) || (job.readLen == 0)) {
+            // With nothing to read either, the first TXIFG sends the stop straight after the address: an address-only probe
+            SET_BITS(CTLW0, UCTR | UCTXSTT);
+        } else {
+            beginRead(job);
+        }
+    }
+
+    /// Start the next pending job, if there is one.
+    static void startNext() {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t n = 0; n < s.jobCount; n++) {
+            uint8_t i = s.next;
+            s.next = (s.next + 1 == s.jobCount) ? 0 : s.next + 1;
+            if (s.jobs[i].pending) {
+                startJob(i);
+                return;
+            }
+        }
+        #pragma diag_default 1544
+    }
+
+    /// Called once the stop condition has been sent.
+    static void finishJob() {
+        I2cPollJob& job = s.jobs[s.active];
+        if (s.failed) {
+            job.stats.failed++;
+        } else {
+            job.front ^= 1;
+            // Sequence number 0 means 'no result yet', so skip it when wrapping around
+            if (++job.sequence == 0) {
+                job.sequence = 1;
+            }
+            job.stats.completed++;
+        }
+        s.active = -1;
+        startNext();
+    }
+
+    static void enableInterrupts() {
+        *IE = UCTXIE0 | UCRXIE0 | UCNACKIE | UCSTPIE | UCALIE;
+    }
+
+    /// Once the other master has released the bus, switch back to master mode.
+    /// Returns true if the bus can be used again.
+    static bool recoverFromArbitrationLoss() {
+        if (IS_SET(STATW, UCBBUSY)) {
+            return false;
+        }
+        SET_BITS(CTLW0, UCSWRST);
+        SET_BITS(CTLW0, UCMST__MASTER);
+        CLEAR_BITS(CTLW0, UCSWRST); // Clears IE, so re-enable interrupts
+        enableInterrupts();
+        s.lostArbitration = false;
+        return true;
+    }
+
+    public:
+    /// Begin running `count` jobs. Every job is polled on the first tick, and then once every `period` ticks.
+    /// `jobs` must stay valid for as long as the scheduler runs.
+    static void start(I2cPollJob jobs[], uint8_t count) {
+        stop();
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < count; i++) {
+            jobs[i].countdown = 1;
+            jobs[i].pending = false;
+            jobs[i].sequence = 0;
+            jobs[i].stats = {};
+            jobs[i].stats.minInterval = 0xFFFF;
+        }
+        #pragma diag_default 1544
+        s.jobs = jobs;
+        s.jobCount = count;
+        s.active = -1;
+        s.next = 0;
+        s.now = 0;
+        s.lostArbitration = false;
+
+        *IFG = 0;
+        enableInterrupts();
+    }
+
+    /// Stop scheduling jobs. A poll that is in progress is abandoned.
+    static void stop() {
+        *IE = 0;
+        if (IS_SET(STATW, UCBBUSY)) {
+            SET_BITS(CTLW0, UCTXSTP);
+            while (IS_SET(CTLW0, UCTXSTP));
+        }
+        s.jobCount = 0;
+        s.active = -1;
+    }
+
+    /// Advance the scheduler's time base by one tick. Call this from a periodic timer interrupt.
+    static void tick() {
+        s.now++;
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < s.jobCount; i++) {
+            I2cPollJob& job = s.jobs[i];
+            if (--job.countdown == 0) {
+                job.countdown = job.period;
+                if (job.pending || (s.active == i)) {
+                    job.stats.overruns++;
+                } else {
+                    job.pending = true;
+                    job.dueTick = s.now;
+                }
+            }
+        }
+        #pragma diag_default 1544
+        if (s.lostArbitration && !recoverFromArbitrationLoss()) {
+            return;
+        }
+        if (s.active < 0) {
+            startNext();
+        }
+    }
+
+    /// Call this from the eUSCI_B interrupt for this bus.
+    static void handleInterrupt() {
+        if (s.active < 0) {
+            *IFG = 0;
+            return;
+        }
+        I2cPollJob& job = s.jobs[s.active];
+        switch (__even_in_range(*IV, USCI_I2C_UCBIT9IFG)) {
+            case USCI_I2C_UCALIFG:
+                // Another master won the bus. The peripheral is now a slave, so the poll is put back 
+                // in the queue and the bus is recovered on a later tick, once the other master has finished.
+                job.stats.arbitrationLosses++;
+                CLEAR_BITS(IE, UCBIT9IE);
+                job.pending = true;
+                s.active = -1;
+                s.lostArbitration = true;
+                break;
+            case USCI_I2C_UCNACKIFG:
+                s.failed = true;
+                CLEAR_BITS(IE, UCBIT9IE);
+                SET_BITS(CTLW0, UCTXSTP);
+                break;
+            case USCI_I2C_UCSTPIFG:
+                CLEAR_BITS(IE, UCBIT9IE);
+                finishJob();
+                break;
+            case USCI_I2C_UCRXIFG0:
+                if (s.index >= job.readLen) {
+                    // The stop of a single byte read was late, so the slave sent an extra byte. Discard it.
+                    (void)*RXBUF;
+                    break;
+                }
+                backBuffer(job)[s.index++] = *RXBUF;
+                if (job.readLen - s.index == 1) {
+                    // Schedule a stop before the last byte is received
+                    SET_BITS(CTLW0, UCTXSTP);
+                }
+                break;
+            case USCI_I2C_UCTXIFG0:
+                if (s.index < job.writeLen) {
+                    *TXBUF = job.writeData[s.index++];
+                } else if (job.readLen > 0) {
+                    beginRead(job);
+                } else {
+                    SET_BITS(CTLW0, UCTXSTP);
+                }
+                break;
+            case USCI_I2C_UCBIT9IFG:
+                // The address of a single byte read has been ACKed (or NACKed, which is handled above), so schedule the stop
+                CLEAR_BITS(IE, UCBIT9IE);
+                SET_BITS(CTLW0, UCTXSTP);
+                break;
+            default:
+                break;
+        }
+    }
+
+    /// Copy the most recent result of job `i` into `dest` (which must be at least readLen bytes long).
+    /// The copy is always a single, complete result, even if a poll finishes part way through copying.
+    /// Returns false if the job hasn't completed successfully yet.
+    static bool readLatest(uint8_t i, uint8_t dest[]) {
+        I2cPollJob& job = s.jobs[i];
+        uint16_t seq;
+        do {
+            seq = job.sequence;
+            const uint8_t* src = job.buffers + (job.front * job.readLen);
+            #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+            for (uint8_t n = 0; n < job.readLen; n++) {
+                dest[n] = src[n];
+            }
+            #pragma diag_default 1544
+        } while (seq != job.sequence);
+        return seq != 0;
+    }
+
+    /// Returns the timing statistics of job `i`.
+    static const I2cPollStats& stats(uint8_t i) {
+        return s.jobs[i].stats;
+    }
+};
+
+template<
+    volatile uint16_t* CTLW0,
+    volatile uint16_t* CTLW1,
+    volatile uint16_t* BRW,
+    volatile uint16_t* STATW,
+    volatile uint16_t* RXBUF,
+    volatile uint16_t* TXBUF,
+    volatile uint16_t* SA,
+    volatile uint16_t* IE,
+    volatile uint16_t* IFG,
+    volatile uint16_t* IV
+>
+typename I2cScheduler<CTLW0, CTLW1, BRW, STATW, RXBUF, TXBUF, SA, IE, IFG, IV>::State
+    I2cScheduler<CTLW0, CTLW1, BRW, STATW, RXBUF, TXBUF, SA, IE, IFG, IV>::s = {};
+
+#endif /* I2C_SCHEDULER_HPP */
@@ -0,0 +1,152 @@
+#ifndef INIT_SEQUENCE_HPP
+#define INIT_SEQUENCE_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "clock.hpp"
+#include "gpio.hpp"
+
+/// The kinds of step that can appear in a device initialisation sequence.
+enum class InitStepType : uint8_t {
+    /// Write a value to a register.
+    Write,
+    /// Wait for some number of milliseconds.
+    Delay,
+    /// Repeatedly read a register until (reading & mask) == value.
+    PollUntil,
+};
+
+/// A single step of a device initialisation sequence. Use the constexpr functions below to build steps.
+/// Sequences should be declared as `const` arrays so that the linker keeps them in FRAM rather than copying them into RAM.
+/// The register and value are stored next to each other so a register write can be sent straight from FRAM to the bus.
+struct InitStep {
+    InitStepType type;
+    uint8_t mask;
+    /// bytes[0] = register, bytes[1] = value. For delays this holds the length of the delay in milliseconds instead.
+    uint8_t bytes[2];
+
+    /// Write `value` to the register `reg`.
+    static constexpr InitStep write(uint8_t reg, uint8_t value) {
+        return {InitStepType::Write, 0xFF, {reg, value}};
+    }
+
+    /// Wait for `ms` milliseconds before moving on to the next step.
+    static constexpr InitStep delayMs(uint16_t ms) {
+        return {InitStepType::Delay, 0x00, {uint8_t(ms >> 8), uint8_t(ms & 0xFF)}};
+    }
+
+    /// Repeatedly read the register `reg` until (reading & mask) == value, e.g. for waiting on a 'reset done' bit.
+    static constexpr InitStep pollUntil(uint8_t reg, uint8_t mask, uint8_t value) {
+        return {InitStepType::PollUntil, mask, {reg, value}};
+    }
+
+    uint8_t reg() const {
+        return bytes[0];
+    }
+
+    uint8_t value() const {
+        return bytes[1];
+    }
+
+    uint16_t delayLength() const {
+        return (uint16_t(bytes[0]) << 8) | bytes[1];
+    }
+};
+
+/// Plays an initialisation sequence (a list of InitSteps) to a device over I2C or SPI.
+/// `MclkHz` is the MCLK frequency that Delay steps busy-wait at. It defaults to HAL_MCLK_HZ, like delayMs(). With a ClockConfig, pass
+/// its frequency, e.g. `InitSequence<SystemClock::mclkHz>`. `MaxPolls` is how many times a PollUntil step reads its register before giving up.
+template<uint32_t MclkHz = HAL_MCLK_HZ, uint16_t MaxPolls = 1000>
+struct InitSequence {
+    private:
+    static constexpr uint32_t cyclesPerMs = detail::cyclesForMs(MclkHz, 1);
+    static_assert(cyclesPerMs > 0, "MclkHz is too low for millisecond delays");
+
+    static void delay(uint16_t ms) {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint16_t i = 0; i < ms; i++) {
+            __delay_cycles(cyclesPerMs);
+        }
+        #pragma diag_default 1544
+    }
+
+    public:
+    /// Play `len` steps to the I2C device at `address`. Each Write step is sent as its own transaction: | S | addr+W | reg | value | P |.
+    /// PollUntil steps write the register number then read back one byte: | S | addr+W | reg | R | addr+R | ->reading | P |.
+    /// Returns -1 if every step succeeded, otherwise returns the index of the step that failed (NACK or poll timeout).
+    template<typename I2c>
+    static int16_t playI2c(I2c& i2c, uint16_t address, const InitStep steps[], uint16_t len) {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint16_t i = 0; i < len; i++) {
+            const InitStep& step = steps[i];
+            switch (step.type) {
+                case InitStepType::Write:
+                    if (i2c.write(address, step.bytes, 2) != -1) {
+                        return i;
+                    }
+                    break;
+                case InitStepType::Delay:
+                    delay(step.delayLength());
+                    break;
+                case InitStepType::PollUntil: {
+                    uint16_t polls = 0;
+                    uint8_t reading;
+                    while (1) {
+                        if (i2c.write_read(address, step.bytes, 1, &reading, 1) != -1) {
+                            return i;
+                        }
+                        if ((reading & step.mask) == step.value()) {
+                            break;
+                        }
+                        if (++polls == MaxPolls) {
+                            return i;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+        #pragma diag_default 1544
+        return -1;
+    }
+
+    /// Play `len` steps to an SPI device. Each Write step is sent as its own transaction (chip select toggled): | reg | value |.
+    /// PollUntil steps send the register number followed by a dummy byte, and the byte received during the dummy byte is checked.
+    /// Many devices require a 'read' bit to be set in the register address; if so, include it in the `reg` of the PollUntil step.
+    /// Returns -1 if every step succeeded, otherwise returns the index of the step that failed (poll timeout).
+    template<typename Spi, typename Pin>
+    static int16_t playSpi(Spi& spi, Pin& chipSel, const InitStep steps[], uint16_t len) {
+        static_assert(Gpio::isPinType<Pin>(), "chipSel must be of type Pin<...>");
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint16_t i = 0; i < len; i++) {
+            const InitStep& step = steps[i];
+            switch (step.type) {
+                case InitStepType::Write:
+                    spi.write(step.bytes, 2, chipSel);
+                    break;
+                case InitStepType::Delay:
+                    delay(step.delayLength());
+                    break;
+                case InitStepType::PollUntil: {
+                    uint16_t polls = 0;
+                    uint8_t recv[2];
+                    while (1) {
+                        spi.transfer(step.bytes, 1, recv, 2, chipSel);
+                        if ((recv[1] & step.mask) == step.value()) {
+                            break;
+                        }
+                        if (++polls == MaxPolls) {
+                            return i;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+        #pragma diag_default 1544
+        return -1;
+    }
+};
+
+#endif /* INIT_SEQUENCE_HPP */
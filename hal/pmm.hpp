@@ -4,6 +4,8 @@
 #include <msp430.h>
 #include <stdint.h>
 
+#include "util.hpp"
+
 /// List of possible values that the internal voltage reference can take on.
 enum class VrefValue {
     _2V5 = REFVSEL_2,
@@ -19,14 +21,26 @@ struct Vref {
     public:
     static constexpr int8_t adcChannel = 13;
 
-    /// Enable the internal voltage reference.
+    /// Enable the internal voltage reference, and wait for it to settle.
     /// Returns a token that proves the voltage reference is active. Can be passed to the ADC for reading.
     static const Vref enable(VrefValue vref) {
         uint8_t refvsel = static_cast<uint16_t>(vref);
 
         PMMCTL2 = (PMMCTL2 & ~REFVSEL) | refvsel | INTREFEN_1;
+        // Conversions taken before the bandgap and reference generator are ready read garbage
+        while (!ALL_SET(&PMMCTL2, REFBGRDY | REFGENRDY));
         return Vref {};
     }
+
+    /// Returns true if the internal voltage reference is enabled.
+    static bool isEnabled() {
+        return PMMCTL2 & INTREFEN;
+    }
+
+    /// Disable the internal voltage reference to save power. Any Vref or TempSensor tokens must not be used afterwards.
+    static void disable() {
+        PMMCTL2 &= ~(INTREFEN | TSENSOREN);
+    }
 };
 
 /// Struct representing a properly configured internal temperature sensor. Can be passed to the ADC to read channel 12.
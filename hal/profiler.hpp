@@ -0,0 +1,216 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "timer_b.hpp"
+#include "printf/printf.h"
+
+// Profiling is only compiled in when HAL_PROFILING is defined (e.g. `--define=HAL_PROFILING` in debug builds).
+// Otherwise PROFILE_SCOPE() expands to nothing and the Profiler functions are empty, so the instrumentation can stay in the code.
+
+/// The Timer_B instance that counts cycles for the profiler, when HAL_PROFILING is defined. Nothing else may use it.
+#ifndef HAL_PROFILING_TIMER
+#define HAL_PROFILING_TIMER TIMER_B1
+#endif
+
+/// Statistics for one profiled scope, in SMCLK cycles (which are MCLK cycles when SMCLK isn't divided). PROFILE_SCOPE() declares these for you.
+struct ProfileStats {
+    const char* name;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    // Managed by the Profiler
+    ProfileStats* next;
+    bool linked;
+
+    /// Empty statistics for the scope `name`. Constexpr, so a static ProfileStats is set up at load time, with no guard in the scope.
+    constexpr explicit ProfileStats(const char* name) : name(name), count(0), min(0), max(0), total(0), next(nullptr), linked(false) {}
+};
+
+#ifdef HAL_PROFILING
+
+/// Measures how long scopes take, with a Timer_B counting SMCLK and extended to 32 bits by its overflow interrupt.
+/// Timer_B can't count MCLK directly, so leave SMCLK undivided to measure CPU cycles. Mark scopes with PROFILE_SCOPE():
+/// ```
+/// void readSensor() {
+///     PROFILE_SCOPE("readSensor");
+///     ...
+/// }
+/// ```
+/// Call Profiler::start() during startup, forward the timer's TIMERx_B1 interrupt (TIMER1_B1_VECTOR for the default timer) to handleInterrupt(),
+/// and call `Profiler::dump<Uart<...>>()` to print the statistics. The cost of taking the timestamps is measured by start() and subtracted,
+/// so an empty scope reads as about 0 cycles. Interrupts that run during a scope are counted as part of it.
+struct Profiler {
+    private:
+    using Timer = TimerB<HAL_PROFILING_TIMER>;
+    using Config = TimerConfig<TimerClockSource::Smclk, TimerMode::Continuous, 1, TimerCounterLength::_16Bit, true>;
+
+    struct State {
+        /// The upper 16 bits of the cycle count
+        volatile uint16_t high;
+        /// The cycles taken by the profiler itself in each measurement
+        uint16_t overhead;
+        /// Every scope that has been measured, most recent first
+        ProfileStats* first;
+    };
+
+    static State& state() {
+        static State s = {};
+        return s;
+    }
+
+    public:
+    /// Start the cycle counter and measure the profiler's own overhead.
+    static void start() {
+        state().high = 0;
+        Timer::init<Config>();
+        Timer::start<Config>();
+
+        uint32_t overhead = 0xFFFFFFFF;
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < 8; i++) {
+            uint32_t before = now();
+            uint32_t after = now();
+            if (after - before < overhead) {
+                overhead = after - before;
+            }
+        }
+        #pragma diag_default 1544
+        state().overhead = uint16_t(overhead);
+    }
+
+    /// Call this from the profiling timer's TIMERx_B1 interrupt. Never needs to wake the CPU, so always returns false.
+    static bool handleInterrupt() {
+        if (Timer::pendingInterrupt() == Timer::overflowInterrupt) {
+            state().high++;
+        }
+        return false;
+    }
+
+    /// The current cycle count.
+    static uint32_t now() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint16_t high = state().high;
+        uint16_t low = Timer::count();
+        if (Timer::overflowFlagSet()) {
+            // The counter has overflowed, but the interrupt hasn't run yet. Read again in case the overflow happened after the first read.
+            low = Timer::count();
+            high++;
+        }
+        __set_interrupt_state(interruptState);
+        return (uint32_t(high) << 16) | low;
+    }
+
+    /// Add a measurement of `cycles` to `stats`.
+    static void record(ProfileStats& stats, uint32_t cycles) {
+        cycles = (cycles > state().overhead) ? (cycles - state().overhead) : 0;
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        if (!stats.linked) {
+            stats.next = state().first;
+            state().first = &stats;
+            stats.linked = true;
+        }
+        if ((stats.count == 0) || (cycles < stats.min)) {
+            stats.min = cycles;
+        }
+        if (cycles > stats.max) {
+            stats.max = cycles;
+        }
+        stats.total += cycles;
+        stats.count++;
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Clear the statistics of every scope.
+    static void reset() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        for (ProfileStats* stats = state().first; stats; stats = stats->next) {
+            stats->count = 0;
+            stats->min = 0;
+            stats->max = 0;
+            stats->total = 0;
+        }
+        __set_interrupt_state(interruptState);
+    }
+
+    /// The most recently added scope's statistics, or nullptr if nothing has been measured. Follow `next` for the rest.
+    static const ProfileStats* first() {
+        return state().first;
+    }
+
+    /// Print one line of statistics per scope over `Uart` (e.g. `Uart<UART_A0>`), in cycles: name, count, min, mean, max, total.
+    template<typename Uart>
+    static void dump() {
+        char line[112];
+        for (const ProfileStats* stats = state().first; stats; stats = stats->next) {
+            // Copy the statistics so they can't change while they're printed
+            uint16_t interruptState = __get_interrupt_state();
+            __disable_interrupt();
+            ProfileStats copy = *stats;
+            __set_interrupt_state(interruptState);
+
+            unsigned long mean = (copy.count != 0) ? (unsigned long)(copy.total / copy.count) : 0;
+            int len = snprintf_(line, sizeof(line), "%s: count %lu, min %lu, mean %lu, max %lu, total %llu\r\n",
+                copy.name, (unsigned long)copy.count, (unsigned long)copy.min, mean, (unsigned long)copy.max, (unsigned long long)copy.total);
+            if (len < 0) {
+                continue;
+            }
+            if (len >= int(sizeof(line))) {
+                len = sizeof(line) - 1;
+            }
+            Uart::write(reinterpret_cast<const uint8_t*>(line), uint16_t(len));
+        }
+    }
+};
+
+/// Measures the time from its construction to its destruction, and adds it to a ProfileStats. Usually declared with PROFILE_SCOPE().
+class ProfileScope {
+    ProfileStats& stats;
+    uint32_t start;
+
+    public:
+    explicit ProfileScope(ProfileStats& stats) : stats(stats), start(Profiler::now()) {}
+
+    ~ProfileScope() {
+        Profiler::record(stats, Profiler::now() - start);
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+/// Profile the rest of the enclosing scope, under `name` (a string literal).
+#define PROFILE_SCOPE(name) \
+    static ProfileStats PROFILE_CONCAT(profileStats_, __LINE__)(name); \
+    ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(PROFILE_CONCAT(profileStats_, __LINE__))
+
+#else
+
+// Profiling disabled: everything compiles away
+
+struct Profiler {
+    static void start() {}
+    static bool handleInterrupt() { return false; }
+    static uint32_t now() { return 0; }
+    static void reset() {}
+    static const ProfileStats* first() { return nullptr; }
+    template<typename Uart>
+    static void dump() {}
+};
+
+class ProfileScope {
+    public:
+    explicit ProfileScope(ProfileStats&) {}
+};
+
+#define PROFILE_SCOPE(name)
+
+#endif /* HAL_PROFILING */
+
+#endif /* PROFILER_HPP */
@@ -0,0 +1,159 @@
+#ifndef PWM_HPP
+#define PWM_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "util.hpp"
+#include "timer_b.hpp"
+
+/// Number of timer ticks in each PWM period, for a timer clock of `timerHz` and a PWM frequency of `pwmHz`.
+/// The longest period is 65535 ticks, which at 24MHz gives a PWM frequency of about 366Hz.
+constexpr uint32_t pwmPeriodTicks(uint32_t timerHz, uint32_t pwmHz) {
+    return timerHz / pwmHz;
+}
+
+/// Edge-aligned PWM on channels 1 to Timer::channels - 1 of a Timer_B instance (e.g. 2 outputs on TB0-TB2, 6 on TB3). CCR0 sets the period,
+/// so it isn't available as an output. The timer counts `PeriodTicks` ticks of `Source` / `Divider` per period, and each duty cycle can be set to
+/// any whole number of ticks from 0 to PeriodTicks, so the resolution is PeriodTicks steps. PeriodTicks is at most 65535 rather than 65536: a duty of
+/// PeriodTicks is written to its CCR as a value past CCR0 (PeriodTicks - 1), which the count never reaches, so the output stays high for 100%.
+///
+/// Duty cycle changes never glitch: the compare latches only load at the end of a period (CLLD), and they are grouped (TBCLGRP) so they all
+/// load together. A grouped latch only loads once every CCR in the group has been written, so a set of changes made with setDuties() always
+/// appears in the same period, even if a period ends part way through writing them.
+///
+/// Connect each output to its pin with PinFunction, e.g. on TB3 (channels 1-6 are P6.0-P6.5):
+/// ```
+/// using MotorPwm = Pwm<TimerB<TIMER_B3>, TimerClockSource::Smclk, pwmPeriodTicks(SystemClock::smclkHz, 20000)>; // 20kHz
+/// Pin<P6,0>::toOutput().function(PinFunction::Primary);
+/// MotorPwm::init();
+/// MotorPwm::setDuty<1>(0x4000); // 25%
+/// ```
+template<typename Timer, TimerClockSource Source, uint32_t PeriodTicks, uint8_t Divider = 1>
+struct Pwm {
+    static_assert((PeriodTicks >= 2) && (PeriodTicks <= 65535), "The period must be between 2 and 65535 timer ticks");
+
+    /// Number of PWM outputs.
+    static constexpr uint8_t outputs = Timer::channels - 1;
+
+    /// The timer configuration: up mode, with every compare latch in one group.
+    struct Config : TimerConfig<Source, TimerMode::Up, Divider> {
+        static constexpr uint16_t stoppedCtl = TimerConfig<Source, TimerMode::Up, Divider>::stoppedCtl | TBCLGRP_3;
+        static constexpr uint16_t runningCtl = TimerConfig<Source, TimerMode::Up, Divider>::runningCtl | TBCLGRP_3;
+    };
+
+    /// PWM frequency in Hz, for a source clock of `sourceHz`.
+    static constexpr uint32_t frequencyHz(uint32_t sourceHz) {
+        return sourceHz / Divider / PeriodTicks;
+    }
+
+    private:
+    struct State {
+        /// The duty cycle of each output, in ticks. Element 0 is channel 1.
+        uint16_t duty[Timer::channels - 1];
+    };
+    static State s;
+
+    /// Write every CCR, so the grouped latches load at the end of this period
+    static void commit() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        *Timer::compareRegister(0) = uint16_t(PeriodTicks - 1);
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < outputs; i++) {
+            *Timer::compareRegister(i + 1) = s.duty[i];
+        }
+        #pragma diag_default 1544
+        __set_interrupt_state(interruptState);
+    }
+
+    static uint16_t clampTicks(uint16_t ticks) {
+        return (ticks > PeriodTicks) ? uint16_t(PeriodTicks) : ticks;
+    }
+
+    /// Scaling by PeriodTicks + 1 maps 0xFFFF to PeriodTicks, and 0x8000 to half the period
+    static uint16_t fractionToTicks(uint16_t fraction) {
+        return uint16_t((uint32_t(fraction) * (PeriodTicks + 1)) >> 16);
+    }
+
+    public:
+    /// Configure the timer and start it, with every output at 0 duty. Outputs go high at the start of each period and low after their duty cycle.
+    /// Each channel's pin must be connected separately with PinFunction.
+    static void init() {
+        Timer::template init<Config>();
+        // While stopped, load the latches as soon as the CCRs are written. Afterwards, load them at the end of each period.
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t n = 0; n < Timer::channels; n++) {
+            *Timer::controlRegister(n) = (n == 0) ? CLLD_0 : (OUTMOD_7 | CLLD_0);
+        }
+        for (uint8_t i = 0; i < outputs; i++) {
+            s.duty[i] = 0;
+        }
+        commit();
+        for (uint8_t n = 0; n < Timer::channels; n++) {
+            SET_BITS(Timer::controlRegister(n), CLLD_1);
+        }
+        #pragma diag_default 1544
+        Timer::template start<Config>();
+    }
+
+    /// Start the timer again after stop().
+    static void start() {
+        Timer::template start<Config>();
+    }
+
+    /// Stop the timer. The outputs keep their current levels.
+    static void stop() {
+        Timer::template stop<Config>();
+    }
+
+    /// Set output `N`'s duty cycle in timer ticks, from 0 to PeriodTicks (always high). Takes effect at the end of the current period.
+    /// A duty of 0 still leaves the output high for up to one tick per period. For a constant low, switch the channel to TimerOutputMode::Output.
+    template<uint8_t N>
+    static void setDutyTicks(uint16_t ticks) {
+        static_assert((N >= 1) && (N <= outputs), "PWM outputs are channels 1 to Timer::channels - 1");
+        s.duty[N - 1] = clampTicks(ticks);
+        commit();
+    }
+
+    /// Set output `N`'s duty cycle as a fraction of the period, from 0 to 0xFFFF (100%), so 0x8000 is 50%. Takes effect at the end of the current period.
+    template<uint8_t N>
+    static void setDuty(uint16_t fraction) {
+        static_assert((N >= 1) && (N <= outputs), "PWM outputs are channels 1 to Timer::channels - 1");
+        s.duty[N - 1] = fractionToTicks(fraction);
+        commit();
+    }
+
+    /// Set the duty cycles of all of the outputs at once, in timer ticks. `ticks[0]` is channel 1. All of the changes take effect together, at the end of the current period.
+    static void setDutiesTicks(const uint16_t ticks[outputs]) {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < outputs; i++) {
+            s.duty[i] = clampTicks(ticks[i]);
+        }
+        #pragma diag_default 1544
+        commit();
+    }
+
+    /// Set the duty cycles of all of the outputs at once, as fractions of the period (see setDuty()). `fractions[0]` is channel 1.
+    /// All of the changes take effect together, at the end of the current period.
+    static void setDuties(const uint16_t fractions[outputs]) {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t i = 0; i < outputs; i++) {
+            s.duty[i] = fractionToTicks(fractions[i]);
+        }
+        #pragma diag_default 1544
+        commit();
+    }
+
+    /// Output `N`'s duty cycle in timer ticks.
+    template<uint8_t N>
+    static uint16_t dutyTicks() {
+        static_assert((N >= 1) && (N <= outputs), "PWM outputs are channels 1 to Timer::channels - 1");
+        return s.duty[N - 1];
+    }
+};
+
+template<typename Timer, TimerClockSource Source, uint32_t PeriodTicks, uint8_t Divider>
+typename Pwm<Timer, Source, PeriodTicks, Divider>::State Pwm<Timer, Source, PeriodTicks, Divider>::s;
+
+#endif /* PWM_HPP */
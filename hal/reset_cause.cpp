@@ -0,0 +1,110 @@
+#include <msp430.h>
+#include <stdint.h>
+
+#include "fram.hpp"
+#include "reset_cause.hpp"
+
+struct ResetStore {
+    uint16_t counts[ResetLog::causeSlots];
+    uint16_t total;
+    ResetRecord history[HAL_RESET_HISTORY];
+    /// Where the next reset goes in the history
+    uint8_t next;
+    uint8_t length;
+    uint32_t uptime;
+};
+
+// Kept in FRAM, so it survives resets. Zeroed when the device is programmed.
+#pragma PERSISTENT(resetStore)
+static ResetStore resetStore = {{0}};
+
+// This boot's causes, in RAM. Cleared by the C startup code at every reset.
+static bool captured = false;
+static ResetCause latestCause = ResetCause::None;
+static uint32_t latestCauses = 0;
+
+static void increment(uint16_t& counter) {
+    if (counter != 0xFFFF) {
+        counter++;
+    }
+}
+
+ResetCause ResetLog::capture() {
+    if (captured) {
+        return latestCause;
+    }
+    captured = true;
+
+    FramWriteEnable unlock;
+    // Each read returns the highest priority pending cause and clears it, until there are none left
+    uint16_t iv;
+    while ((iv = SYSRSTIV) != 0) {
+        uint8_t slot = uint8_t(iv >> 1);
+        if (slot >= causeSlots) {
+            continue;
+        }
+        if (latestCauses == 0) {
+            latestCause = static_cast<ResetCause>(iv);
+        }
+        latestCauses |= uint32_t(1) << slot;
+        increment(resetStore.counts[slot]);
+    }
+    if (latestCauses == 0) {
+        return latestCause;
+    }
+    if (!HAL_RESET_LOG_LPM5_WAKEUPS && (latestCauses == (uint32_t(1) << (static_cast<uint8_t>(ResetCause::Lpm5Wakeup) >> 1)))) {
+        // Just a wakeup, which the application keeps running through
+        return latestCause;
+    }
+
+    increment(resetStore.total);
+    ResetRecord& record = resetStore.history[resetStore.next];
+    record.cause = latestCause;
+    record.causes = latestCauses;
+    record.uptime = resetStore.uptime;
+    resetStore.uptime = 0;
+    resetStore.next = (resetStore.next + 1 < HAL_RESET_HISTORY) ? (resetStore.next + 1) : 0;
+    if (resetStore.length < HAL_RESET_HISTORY) {
+        resetStore.length++;
+    }
+    return latestCause;
+}
+
+ResetCause ResetLog::cause() {
+    return latestCause;
+}
+
+bool ResetLog::causedBy(ResetCause cause) {
+    return latestCauses & (uint32_t(1) << (static_cast<uint8_t>(cause) >> 1));
+}
+
+uint16_t ResetLog::count(ResetCause cause) {
+    return resetStore.counts[static_cast<uint8_t>(cause) >> 1];
+}
+
+uint16_t ResetLog::total() {
+    return resetStore.total;
+}
+
+uint8_t ResetLog::historyLength() {
+    return resetStore.length;
+}
+
+bool ResetLog::history(uint8_t age, ResetRecord& record) {
+    if (age >= resetStore.length) {
+        return false;
+    }
+    uint8_t index = (resetStore.next + HAL_RESET_HISTORY - 1 - age) % HAL_RESET_HISTORY;
+    record = resetStore.history[index];
+    return true;
+}
+
+void ResetLog::setUptime(uint32_t uptime) {
+    FramWriteEnable unlock;
+    resetStore.uptime = uptime;
+}
+
+void ResetLog::clear() {
+    FramWriteEnable unlock;
+    resetStore = ResetStore {};
+}
@@ -0,0 +1,114 @@
+#ifndef RESET_CAUSE_HPP
+#define RESET_CAUSE_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+/// Number of resets kept in the ResetLog history. Define it for the whole project to change it.
+#ifndef HAL_RESET_HISTORY
+#define HAL_RESET_HISTORY 8
+#endif
+
+/// Waking from LPM3.5 or LPM4.5 goes through a reset, but it's how a sleeping application runs, not a fault. By default a wakeup with no other
+/// cause is only counted in count(ResetCause::Lpm5Wakeup): it's left out of total() and the history, and doesn't restart the uptime, so it
+/// doesn't push the real resets out. Define this as 1 for the whole project to log wakeups like any other reset.
+#ifndef HAL_RESET_LOG_LPM5_WAKEUPS
+#define HAL_RESET_LOG_LPM5_WAKEUPS 0
+#endif
+
+/// What caused a reset. The values are those read from SYSRSTIV, in order of priority (lowest value first).
+enum class ResetCause : uint8_t {
+    None              = 0x00,
+    /// Brownout: power-up, or the supply dropped too low
+    Brownout          = 0x02,
+    /// The RST/NMI pin
+    ResetPin          = 0x04,
+    /// A software BOR (PMMSWBOR)
+    SoftwareBor       = 0x06,
+    /// Wakeup from LPM3.5 or LPM4.5
+    Lpm5Wakeup        = 0x08,
+    /// A security violation
+    SecurityViolation = 0x0A,
+    /// The high-side supply supervisor (SVSH) saw the supply drop below its threshold
+    SupplySupervisor  = 0x0E,
+    /// A software POR (PMMSWPOR)
+    SoftwarePor       = 0x14,
+    /// The watchdog expired
+    WatchdogTimeout   = 0x16,
+    /// WDTCTL written without the password
+    WatchdogPassword  = 0x18,
+    /// FRCTL0 written without the password
+    FramPassword      = 0x1A,
+    /// An uncorrectable FRAM bit error
+    FramBitError      = 0x1C,
+    /// An instruction fetch from the peripheral area
+    PeripheralFetch   = 0x1E,
+    /// PMMCTL0 written without the password
+    PmmPassword       = 0x20,
+    /// The FLL lost lock
+    FllUnlock         = 0x24,
+};
+
+/// One reset in the ResetLog history.
+struct ResetRecord {
+    /// The highest priority cause.
+    ResetCause cause;
+    /// Every cause reported for this reset, one bit per cause: bit n is set for the cause with value 2n.
+    uint32_t causes;
+    /// The last uptime given to ResetLog::setUptime() before the reset.
+    uint32_t uptime;
+
+    /// Returns true if `cause` was one of the causes of this reset.
+    bool causedBy(ResetCause cause) const {
+        return causes & (uint32_t(1) << (static_cast<uint8_t>(cause) >> 1));
+    }
+};
+
+/// Decodes the cause of each reset and keeps statistics in FRAM across resets: a counter per cause, and the last HAL_RESET_HISTORY resets
+/// with the uptime at which each happened. Requires reset_cause.cpp to be part of the build.
+///
+/// Call capture() once at the start of main(), before anything else reads SYSRSTIV. It takes a few microseconds.
+/// ```
+/// int main() {
+///     ResetLog::capture();
+///     if (ResetLog::cause() == ResetCause::WatchdogTimeout) { ... }
+/// }
+/// ```
+/// For the uptime at each reset, call setUptime() periodically (e.g. from the RTC interrupt, in seconds). The value is kept in FRAM, and
+/// copied into the history at the next reset, so it's the uptime to within one update.
+struct ResetLog {
+    /// Number of distinct SYSRSTIV values (0x00 to 0x24).
+    static constexpr uint8_t causeSlots = 0x26 / 2;
+
+    /// Read every cause from SYSRSTIV, count them, and add the reset to the history. Returns the highest priority cause.
+    /// Only the first call after each reset does anything: later calls just return the cause.
+    static ResetCause capture();
+
+    /// The highest priority cause of the latest reset, as found by capture().
+    static ResetCause cause();
+
+    /// Returns true if `cause` was one of the causes of the latest reset.
+    static bool causedBy(ResetCause cause);
+
+    /// Number of resets with `cause` among their causes, since the device was programmed or clear() was called. Stops at 65535.
+    static uint16_t count(ResetCause cause);
+
+    /// Number of resets since the device was programmed or clear() was called, not counting LPMx.5 wakeups (see HAL_RESET_LOG_LPM5_WAKEUPS).
+    /// Stops at 65535.
+    static uint16_t total();
+
+    /// Number of resets in the history, up to HAL_RESET_HISTORY.
+    static uint8_t historyLength();
+
+    /// Copy a reset from the history into `record`: 0 is the latest reset, 1 the one before, and so on.
+    /// Returns false if the history doesn't go back that far.
+    static bool history(uint8_t age, ResetRecord& record);
+
+    /// Record the current uptime, in any unit. It's kept in FRAM, so if a reset happens before the next call it's recorded with the reset.
+    static void setUptime(uint32_t uptime);
+
+    /// Clear the counters and the history.
+    static void clear();
+};
+
+#endif /* RESET_CAUSE_HPP */
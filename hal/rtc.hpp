@@ -0,0 +1,165 @@
+#ifndef RTC_HPP
+#define RTC_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+/// The clock that the RTC counter counts.
+enum class RtcSource {
+    Smclk = RTCSS__SMCLK,
+    /// A 32768Hz crystal on XT1 (see Xt1::start()). Accurate, and keeps running in LPM3.5.
+    Xt1   = RTCSS__XT1CLK,
+    /// The internal ~10kHz very low power oscillator. Keeps running in LPM3.5 and needs no crystal, but is only accurate to about +-50%.
+    Vlo   = RTCSS__VLOCLK,
+};
+
+// Internal implementation details
+namespace detail {
+    /// The RTC predividers, from finest to coarsest
+    constexpr uint16_t rtcPredividers[] = {1, 10, 16, 64, 100, 256, 1000, 1024};
+
+    /// Number of RTC counts in `intervalMs` at `sourceHz` / `predivider`, rounded to the nearest count.
+    constexpr uint64_t rtcCounts(uint32_t sourceHz, uint32_t intervalMs, uint16_t predivider) {
+        return (uint64_t(sourceHz) * intervalMs + uint64_t(predivider) * 500) / (uint64_t(predivider) * 1000);
+    }
+
+    /// The finest predivider that lets the 16-bit counter reach the interval, or 0 if the interval is too long.
+    constexpr uint16_t rtcPredivider(uint32_t sourceHz, uint32_t intervalMs) {
+        for (uint16_t predivider : rtcPredividers) {
+            if (rtcCounts(sourceHz, intervalMs, predivider) <= 65536) {
+                return predivider;
+            }
+        }
+        return 0;
+    }
+
+    constexpr uint16_t rtcpsBits(uint16_t predivider) {
+        return (predivider == 1)   ? RTCPS__1   : (predivider == 10)   ? RTCPS__10   :
+               (predivider == 100) ? RTCPS__100 : (predivider == 1000) ? RTCPS__1000 :
+               (predivider == 16)  ? RTCPS__16  : (predivider == 64)   ? RTCPS__64   :
+               (predivider == 256) ? RTCPS__256 : RTCPS__1024;
+    }
+
+    /// The nominal frequency of XT1 or VLO. SMCLK has none, so 0 marks a frequency that must be given.
+    constexpr uint32_t rtcNominalHz(RtcSource source) {
+        return (source == RtcSource::Vlo) ? 10000 : (source == RtcSource::Xt1) ? 32768 : 0;
+    }
+}
+
+/// An RTC wakeup interval, fixed at compile time: the predivider and modulo are chosen so the interval is as close as possible to `IntervalMs`,
+/// with the finest resolution available. `SourceHz` defaults to the nominal frequency of XT1 or VLO, and must be given for SMCLK.
+/// ```
+/// using Every10s = RtcConfig<RtcSource::Xt1, 10000>; // Predivider 10, 32768 counts
+/// using Every50ms = RtcConfig<RtcSource::Smclk, 50, SystemClock::smclkHz>;
+/// ```
+template<RtcSource Source, uint32_t IntervalMs, uint32_t SourceHz = detail::rtcNominalHz(Source)>
+struct RtcConfig {
+    static_assert(SourceHz != 0, "SMCLK has no default frequency: give SourceHz, e.g. SystemClock::smclkHz");
+    static_assert(IntervalMs > 0, "The interval must be at least 1ms");
+    static_assert(detail::rtcPredivider(SourceHz, IntervalMs) != 0, "Interval too long for the RTC at this source frequency");
+
+    /// The predivider chosen (1, 10, 16, 64, 100, 256, 1000, or 1024).
+    static constexpr uint16_t predivider = detail::rtcPredivider(SourceHz, IntervalMs);
+    /// Number of counts per interval. At least 1.
+    static constexpr uint32_t counts = (detail::rtcCounts(SourceHz, IntervalMs, predivider) == 0) ? 1 : uint32_t(detail::rtcCounts(SourceHz, IntervalMs, predivider));
+    /// RTCMOD register value. The counter counts from 0 to RTCMOD, so it's one less than the number of counts.
+    static constexpr uint16_t rtcmod = uint16_t(counts - 1);
+    /// RTCCTL register value while running, with the interrupt enabled.
+    static constexpr uint16_t rtcctl = static_cast<uint16_t>(Source) | detail::rtcpsBits(predivider) | RTCIE;
+    /// The actual interval in microseconds, after rounding (at the nominal source frequency).
+    static constexpr uint32_t intervalUs = uint32_t(uint64_t(counts) * predivider * 1000000 / SourceHz);
+};
+
+/// The RTC counter: a 16-bit counter with a predivider, which interrupts (and wakes the CPU) once per interval. It can run in LPM3 and LPM3.5
+/// from XT1 or VLO, which makes it the lowest power way to wake up periodically, e.g. to take a sample every 10s.
+/// Forward the RTC interrupt to handleInterrupt():
+/// ```
+/// #pragma vector=RTC_VECTOR
+/// __interrupt void RTC_ISR(void) {
+///     if (Rtc::handleInterrupt()) {
+///         __bic_SR_register_on_exit(LPM3_bits);
+///     }
+/// }
+/// ```
+/// In LPM3.5 the CPU and RAM are switched off, so the wakeup restarts the program from reset, with the RTC still running.
+/// SYSRSTIV reports an LPMx.5 wakeup, and the RTC interrupt runs once gpioUnlock() clears LOCKLPM5.
+struct Rtc {
+    private:
+    struct State {
+        volatile bool oneShot;
+    };
+
+    static State& state() {
+        static State s = {};
+        return s;
+    }
+
+    public:
+    /// Start waking every interval of `Config` (an RtcConfig). The count restarts from 0.
+    template<typename Config>
+    static void startPeriodic() {
+        state().oneShot = false;
+        RTCMOD = Config::rtcmod;
+        // RTCSR resets the count and loads the new RTCMOD
+        RTCCTL = Config::rtcctl | RTCSR;
+    }
+
+    /// Wake once, one interval of `Config` (an RtcConfig) from now. The counter stops when the interrupt is handled.
+    template<typename Config>
+    static void startOneShot() {
+        state().oneShot = true;
+        RTCMOD = Config::rtcmod;
+        RTCCTL = Config::rtcctl | RTCSR;
+    }
+
+    /// Stop the counter. With no source selected it draws no current.
+    static void stop() {
+        RTCCTL = RTCSS__DISABLED;
+    }
+
+    /// Returns true if the counter is running.
+    static bool isRunning() {
+        return (RTCCTL & RTCSS) != RTCSS__DISABLED;
+    }
+
+    /// The current count, from 0 to RTCMOD. XT1 and VLO are asynchronous to MCLK, so reads until two consecutive reads agree.
+    static uint16_t count() {
+        uint16_t a;
+        uint16_t b;
+        do {
+            a = RTCCNT;
+            b = RTCCNT;
+        } while (a != b);
+        return a;
+    }
+
+    /// Call this from the RTC interrupt. Returns true at the end of each interval, so the interrupt can wake the CPU.
+    static bool handleInterrupt() {
+        switch (__even_in_range(RTCIV, RTCIV__RTCIFG)) {
+            case RTCIV__RTCIFG:
+                if (state().oneShot) {
+                    stop();
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Enter LPM3.5: everything but the RTC (and its clock) is switched off until the next RTC interrupt, which restarts the program from reset.
+    /// This draws far less than LPM3, but RAM is lost, so keep anything that must survive in FRAM (#pragma PERSISTENT).
+    /// Only returns if an interrupt was already pending, which stops the device entering LPM3.5. The regulator is then left on as before,
+    /// so a later LPM3 sleep doesn't turn into LPM3.5.
+    static void enterLpm35() {
+        PMMCTL0_H = PMMPW_H;
+        PMMCTL0_L |= PMMREGOFF;
+        PMMCTL0_H = 0; // Lock the PMM registers again
+        __bis_SR_register(LPM3_bits | GIE);
+        __no_operation();
+        PMMCTL0_H = PMMPW_H;
+        PMMCTL0_L &= ~PMMREGOFF;
+        PMMCTL0_H = 0;
+    }
+};
+
+#endif /* RTC_HPP */
@@ -0,0 +1,277 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+/// A task's handler. Called with the events posted to the task since it last ran, and runs to completion.
+using TaskHandler = void (*)(uint16_t events);
+
+/// The task table of a Scheduler, in priority order (highest first), e.g. `Tasks<&radioTask, &sensorTask, &uiTask>`.
+/// A task's ID is its index in the list.
+template<TaskHandler... Handlers>
+struct Tasks {};
+
+/// The low power modes, from lightest to deepest. Each one stops more clocks than the last:
+/// LPM0 stops MCLK, LPM1 also stops the FLL, LPM3 also stops SMCLK, and LPM4 also stops ACLK.
+enum class LowPowerMode : uint8_t {
+    Lpm0,
+    Lpm1,
+    Lpm3,
+    Lpm4,
+};
+
+/// The clock for runtime accounting when none is wanted. Every time reads as 0, so only the run counts are kept.
+struct NoTaskClock {
+    static uint32_t now() {
+        return 0;
+    }
+};
+
+/// Runtime statistics for one task, in ticks of the Scheduler's clock.
+struct TaskStats {
+    /// Number of times the handler has run.
+    uint32_t runs;
+    /// Total time spent in the handler.
+    uint32_t totalTicks;
+    /// Longest single run of the handler.
+    uint32_t maxTicks;
+    /// Time from the first event being posted to the handler starting, for the most recent run.
+    uint32_t lastLatency;
+    /// Longest latency seen so far.
+    uint32_t maxLatency;
+};
+
+// Internal implementation details
+namespace detail {
+    constexpr uint16_t lowPowerModeBits[] = {LPM0_bits, LPM1_bits, LPM3_bits, LPM4_bits};
+}
+
+template<typename TaskList, typename Clock = NoTaskClock, LowPowerMode Deepest = LowPowerMode::Lpm3>
+struct Scheduler;
+
+/// A cooperative, event-driven scheduler with a fixed task table. Interrupts post events (bit flags) to tasks, and the scheduler runs each task
+/// with pending events, highest priority first. Handlers run to completion with interrupts enabled, and are never preempted by other tasks,
+/// so tasks need no locking between themselves. When nothing is pending, the CPU sleeps in the deepest low power mode that every peripheral in use allows,
+/// and never deeper than `Deepest`.
+/// ```
+/// enum : uint16_t { RxEvent = 0x01, TimerEvent = 0x02 };
+/// void radioTask(uint16_t events) { ... }
+/// void sensorTask(uint16_t events) { ... }
+/// using App = Scheduler<Tasks<&radioTask, &sensorTask>, Timebase>;
+///
+/// #pragma vector=USCI_A0_VECTOR
+/// __interrupt void USCI_A0_ISR(void) {
+///     ...
+///     if (App::post<0>(RxEvent)) {
+///         __bic_SR_register_on_exit(LPM4_bits); // Wake the scheduler
+///     }
+/// }
+///
+/// int main() {
+///     ...
+///     App::run();
+/// }
+/// ```
+/// Anything that needs a clock while the CPU sleeps must say so with limitSleep(), and call releaseSleep() when done. E.g. a UART clocked from SMCLK
+/// calls `App::limitSleep(LowPowerMode::Lpm1)` before a transfer, so the scheduler won't go deeper than LPM1 (which keeps SMCLK running).
+///
+/// `Deepest` defaults to LPM3, which keeps ACLK running, and with it the Timebase, TimerWheel, RTC and watchdog. Only pass LowPowerMode::Lpm4
+/// if nothing needs a clock while the CPU sleeps, so that only external interrupts can wake it.
+///
+/// Runtime accounting uses `Clock::now()`: Timebase counts in ~30.5us ticks, and Profiler in SMCLK cycles (when HAL_PROFILING is defined).
+/// With the default NoTaskClock, only the run counts are kept, and the timing compiles away.
+template<TaskHandler... Handlers, typename Clock, LowPowerMode Deepest>
+struct Scheduler<Tasks<Handlers...>, Clock, Deepest> {
+    /// Number of tasks.
+    static constexpr uint8_t taskCount = sizeof...(Handlers);
+
+    static_assert(taskCount > 0, "Scheduler needs at least one task");
+    static_assert(taskCount <= 16, "Scheduler supports at most 16 tasks");
+
+    private:
+    struct State {
+        /// One bit per task, set while it has events pending
+        volatile uint16_t ready;
+        volatile uint16_t events[taskCount];
+        /// When the first of each task's pending events was posted
+        uint32_t postedAt[taskCount];
+        TaskStats stats[taskCount];
+        /// Number of limitSleep() calls still in force for LPM0, LPM1 and LPM3 (a limit of LPM4 is no limit)
+        uint8_t restrictions[3];
+        uint32_t sleepTicks;
+    };
+    static State s;
+
+    /// The deepest low power mode allowed by the current restrictions and `Deepest`. Interrupts must be disabled.
+    static uint16_t sleepBits() {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t mode = 0; mode < static_cast<uint8_t>(Deepest); mode++) {
+            if (s.restrictions[mode] != 0) {
+                return detail::lowPowerModeBits[mode];
+            }
+        }
+        #pragma diag_default 1544
+        return detail::lowPowerModeBits[static_cast<uint8_t>(Deepest)];
+    }
+
+    /// Run the highest priority task with pending events. Returns false if there were none. Interrupts must be disabled, and are enabled on return.
+    static bool runNext() {
+        static const TaskHandler handlers[] = {Handlers...};
+
+        uint16_t ready = s.ready;
+        if (ready == 0) {
+            return false;
+        }
+        uint8_t task = 0;
+        while (!(ready & 1)) {
+            ready >>= 1;
+            task++;
+        }
+        uint16_t events = s.events[task];
+        s.events[task] = 0;
+        s.ready &= ~(uint16_t(1) << task);
+        uint32_t postedAt = s.postedAt[task];
+        __enable_interrupt();
+
+        uint32_t start = Clock::now();
+        handlers[task](events);
+        uint32_t ticks = Clock::now() - start;
+
+        __disable_interrupt();
+        TaskStats& stats = s.stats[task];
+        uint32_t latency = start - postedAt;
+        stats.runs++;
+        stats.totalTicks += ticks;
+        if (ticks > stats.maxTicks) {
+            stats.maxTicks = ticks;
+        }
+        stats.lastLatency = latency;
+        if (latency > stats.maxLatency) {
+            stats.maxLatency = latency;
+        }
+        __enable_interrupt();
+        return true;
+    }
+
+    public:
+    /// Post `events` to task `task` (its index in the task list). The events are merged with any already pending, and the task runs once for all of them.
+    /// Safe to call from interrupts and tasks. Returns true so an interrupt can wake the CPU for the scheduler to run the task,
+    /// or false (posting nothing) if there is no such task.
+    static bool post(uint8_t task, uint16_t events) {
+        if (task >= taskCount) {
+            return false;
+        }
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint16_t bit = uint16_t(1) << task;
+        if (!(s.ready & bit)) {
+            s.postedAt[task] = Clock::now();
+            s.ready |= bit;
+        }
+        s.events[task] |= events;
+        __set_interrupt_state(interruptState);
+        return true;
+    }
+
+    /// Post `events` to task `Task`. See post().
+    template<uint8_t Task>
+    static bool post(uint16_t events) {
+        static_assert(Task < taskCount, "No such task");
+        return post(Task, events);
+    }
+
+    /// Returns true if task `task` has events waiting.
+    static bool isPending(uint8_t task) {
+        return (task < taskCount) && (s.ready & (uint16_t(1) << task));
+    }
+
+    /// Stop the scheduler sleeping deeper than `deepest` until a matching releaseSleep(). Calls nest, and are safe from interrupts.
+    static void limitSleep(LowPowerMode deepest) {
+        if (deepest == LowPowerMode::Lpm4) {
+            return;
+        }
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        s.restrictions[static_cast<uint8_t>(deepest)]++;
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Undo one limitSleep() call with the same `deepest`.
+    static void releaseSleep(LowPowerMode deepest) {
+        if (deepest == LowPowerMode::Lpm4) {
+            return;
+        }
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint8_t& count = s.restrictions[static_cast<uint8_t>(deepest)];
+        if (count != 0) {
+            count--;
+        }
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Run every task with pending events, highest priority first, until none are left. Returns without sleeping.
+    /// Use this instead of run() to fit the scheduler into an existing main loop.
+    static void runPending() {
+        __disable_interrupt();
+        while (runNext()) {
+            __disable_interrupt();
+        }
+    }
+
+    /// Run tasks as events arrive, forever. Whenever no events are pending the CPU sleeps in the deepest permitted low power mode,
+    /// until an interrupt posts an event and wakes it with `__bic_SR_register_on_exit(LPM4_bits)` (which clears the bits of any mode).
+    static void run() {
+        while (true) {
+            __disable_interrupt();
+            if (runNext()) {
+                continue;
+            }
+            // Interrupts are still disabled, so an event posted after the check wakes the CPU as soon as it sleeps, rather than being missed
+            uint32_t start = Clock::now();
+            __bis_SR_register(sleepBits() | GIE);
+            __no_operation();
+            s.sleepTicks += Clock::now() - start;
+        }
+    }
+
+    /// A copy of task `task`'s statistics. All zero if there is no such task.
+    static TaskStats stats(uint8_t task) {
+        if (task >= taskCount) {
+            return TaskStats {};
+        }
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        TaskStats copy = s.stats[task];
+        __set_interrupt_state(interruptState);
+        return copy;
+    }
+
+    /// Time spent asleep in run(), including the interrupts that ran while the CPU was asleep.
+    static uint32_t sleepTicks() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint32_t ticks = s.sleepTicks;
+        __set_interrupt_state(interruptState);
+        return ticks;
+    }
+
+    /// Clear every task's statistics and the sleep time.
+    static void resetStats() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t task = 0; task < taskCount; task++) {
+            s.stats[task] = TaskStats {};
+        }
+        #pragma diag_default 1544
+        s.sleepTicks = 0;
+        __set_interrupt_state(interruptState);
+    }
+};
+
+template<TaskHandler... Handlers, typename Clock, LowPowerMode Deepest>
+typename Scheduler<Tasks<Handlers...>, Clock, Deepest>::State Scheduler<Tasks<Handlers...>, Clock, Deepest>::s;
+
+#endif /* SCHEDULER_HPP */
@@ -0,0 +1,96 @@
+#ifndef SUPPLY_MONITOR_HPP
+#define SUPPLY_MONITOR_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "adc.hpp"
+#include "adc_calibration.hpp"
+#include "pmm.hpp"
+
+/// Measures the supply voltage (VCC), e.g. for battery gauging, without any external components.
+/// The internal 1.5V reference is converted with AVCC as the ADC reference: the higher VCC is, the lower the count.
+/// VCC = 1.5V * 2^bits / count, with the 1.5V corrected by this chip's factory calibration.
+///
+/// The ADC must first be initialised with Adc::init(), with a `Resolution` matching the template parameter.
+/// The reference's output impedance is high, so use a long sample time (the datasheet's minimum sample time for the reference channel, at least ~30us).
+///
+/// Cost of each measurement:
+/// - Time: the reference settling time (only if the reference was off; measure() waits for REFGENRDY rather than a fixed worst-case delay),
+///   plus one conversion, conversionClocks() ADCCLK cycles long.
+/// - Energy: that time multiplied by the supply current of the reference and the ADC (see the datasheet's I_REF and I_ADC).
+///   The reference is switched back off afterwards if it was off before, so nothing is drawn between measurements.
+template<AdcResolution Resolution = AdcResolution::_12Bit>
+struct SupplyMonitor {
+    /// Number of ADCCLK cycles the conversion takes, for a given sample time. Divide by the ADCCLK frequency for the conversion time.
+    static constexpr uint16_t conversionClocks(AdcSampleTime sampleTime) {
+        return detail::adcConversionCycles(sampleTime, Resolution);
+    }
+
+    private:
+    struct State {
+        /// Calibrated 1.5V reference voltage, in millivolts << 16. 0 until the calibration has been read.
+        uint32_t refScaled;
+        uint16_t lastSettlePolls;
+    };
+    static State s;
+
+    public:
+    /// Measure VCC, in millivolts. Returns 0 if the conversion failed to produce a sensible result: a count of 0, or one so small that
+    /// VCC would come out above 65535mV.
+    /// The ADC's channel and reference selection are restored afterwards, as is the internal reference's state.
+    static uint16_t measureMillivolts() {
+        if (s.refScaled == 0) {
+            // Read the calibration once: the real 1.5V reference voltage, with 16 fractional bits
+            s.refScaled = (uint32_t(1500) * detail::readTlv(detail::Tlv::ref1V5Factor)) << 1;
+        }
+
+        bool refWasOn = Vref::isEnabled();
+        uint16_t refvsel = PMMCTL2 & REFVSEL;
+        uint16_t polls = 0;
+        PMMCTL2 = (PMMCTL2 & ~REFVSEL) | REFVSEL_0 | INTREFEN_1;
+        while (!ALL_SET(&PMMCTL2, REFBGRDY | REFGENRDY)) {
+            polls++;
+        }
+        s.lastSettlePolls = polls;
+
+        // Convert the reference against AVCC, keeping the caller's ADC setup
+        uint16_t mctl = ADCMCTL0;
+        ADCCTL0 &= ~ADCENC;
+        ADCMCTL0 = (mctl & ~(ADCSREF | ADCINCH)) | ADCSREF_0 | Vref::adcChannel;
+        Adc::enable();
+        ADCCTL0 |= ADCENC | ADCSC;
+        while (Adc::isBusy());
+        uint16_t count = Adc::getConversionResult();
+        ADCCTL0 &= ~ADCENC;
+        ADCMCTL0 = mctl;
+
+        if (!refWasOn) {
+            PMMCTL2 &= ~INTREFEN;
+        } else if (refvsel != REFVSEL_0) {
+            PMMCTL2 = (PMMCTL2 & ~REFVSEL) | refvsel;
+            while (!ALL_SET(&PMMCTL2, REFBGRDY | REFGENRDY));
+        }
+
+        if (count == 0) {
+            return 0;
+        }
+        // refMillivolts * 2^bits / count. refScaled has 16 fractional bits, so shift right by 16 - bits
+        uint32_t millivolts = (s.refScaled / count) >> (16 - detail::adcResolutionBits(Resolution));
+        if (millivolts > 0xFFFF) {
+            return 0;
+        }
+        return uint16_t(millivolts);
+    }
+
+    /// Number of times measureMillivolts() polled the reference before it was ready, on the last measurement.
+    /// 0 means the reference was already on. Each poll is one read and test of PMMCTL2, a few MCLK cycles, so this shows roughly how long settling took.
+    static uint16_t lastSettlePolls() {
+        return s.lastSettlePolls;
+    }
+};
+
+template<AdcResolution Resolution>
+typename SupplyMonitor<Resolution>::State SupplyMonitor<Resolution>::s;
+
+#endif /* SUPPLY_MONITOR_HPP */
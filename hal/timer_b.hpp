@@ -0,0 +1,333 @@
+#ifndef TIMER_B_HPP
+#define TIMER_B_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "util.hpp"
+
+enum class TimerClockSource {
+    /// External TBxCLK pin
+    ExternalTbClk = TBSSEL__TBCLK,
+    Aclk = TBSSEL__ACLK,
+    Smclk = TBSSEL__SMCLK,
+    /// External TBxCLK pin, inverted
+    InvertedTbClk = TBSSEL__INCLK,
+};
+
+enum class TimerMode {
+    /// Count from 0 up to CCR0, then restart from 0. The period is CCR0 + 1 ticks.
+    Up = MC__UP,
+    /// Count from 0 up to the maximum count, then restart from 0.
+    Continuous = MC__CONTINUOUS,
+    /// Count from 0 up to CCR0, then back down to 0. The period is 2 * CCR0 ticks.
+    UpDown = MC__UPDOWN,
+};
+
+/// The maximum count of the timer in continuous mode (and the width of the count in every mode). Timer_B only.
+enum class TimerCounterLength {
+    _16Bit = CNTL__16,
+    _12Bit = CNTL__12,
+    _10Bit = CNTL__10,
+    _8Bit  = CNTL__8,
+};
+
+/// What a capture/compare channel drives its output pin with when the count reaches its CCR (and CCR0, for the modes that use both).
+/// See section 14.2.5 of the user manual.
+enum class TimerOutputMode {
+    /// The output follows the OUT bit, see TimerB::setOutput()
+    Output      = OUTMOD_0,
+    Set         = OUTMOD_1,
+    ToggleReset = OUTMOD_2,
+    SetReset    = OUTMOD_3,
+    Toggle      = OUTMOD_4,
+    Reset       = OUTMOD_5,
+    ToggleSet   = OUTMOD_6,
+    /// Set at CCR0, reset at CCRn. With the timer in up mode this is PWM with a duty cycle of CCRn / (CCR0 + 1).
+    ResetSet    = OUTMOD_7,
+};
+
+/// Which edges of the capture input trigger a capture.
+enum class CaptureEdge {
+    Rising  = CM__RISING,
+    Falling = CM__FALLING,
+    Both    = CM__BOTH,
+};
+
+/// Which signal a channel captures. The A and B inputs are different for each channel, see the 'Timer_B signal connections' tables in the datasheet.
+enum class CaptureInput {
+    A   = CCIS__CCIA,
+    B   = CCIS__CCIB,
+    /// For software captures: toggle between Gnd and Vcc with TimerB::softwareCapture()
+    Gnd = CCIS__GND,
+    Vcc = CCIS__VCC,
+};
+
+// Internal implementation details
+namespace detail {
+    /// The input divider (ID) for a total timer clock divider: the total is ID * TBIDEX, with ID = 1, 2, 4, or 8 and TBIDEX = 1 to 8.
+    /// Returns 0 if the total can't be made.
+    constexpr uint8_t timerInputDivider(uint8_t divider) {
+        for (uint8_t id = 8; id >= 1; id /= 2) {
+            if ((divider % id == 0) && (divider / id <= 8)) {
+                return id;
+            }
+        }
+        return 0;
+    }
+
+    constexpr uint16_t timerIdBits(uint8_t id) {
+        return (id == 8) ? ID__8 : (id == 4) ? ID__4 : (id == 2) ? ID__2 : ID__1;
+    }
+}
+
+/// A complete Timer_B configuration, fixed at compile time, for TimerB::init(), start(), and stop().
+/// Each of those is a single register write of a precalculated value.
+/// `Divider` is the total clock divider, from 1 to 64. It's split between the ID and TBIDEX dividers automatically, so it must be a product of the two
+/// (i.e. 1-8, or an even number up to 16, a multiple of 4 up to 32, or a multiple of 8 up to 64).
+/// ```
+/// using Tick1ms = TimerConfig<TimerClockSource::Smclk, TimerMode::Up, 1>;
+/// TimerB<TIMER_B1>::init<Tick1ms>();
+/// TimerB<TIMER_B1>::setPeriod(Tick1ms::periodTicks(SystemClock::smclkHz, 1000));
+/// TimerB<TIMER_B1>::start<Tick1ms>();
+/// ```
+template<
+    TimerClockSource Source,
+    TimerMode Mode,
+    uint8_t Divider = 1,
+    TimerCounterLength Length = TimerCounterLength::_16Bit,
+    bool OverflowInterrupt = false
+>
+struct TimerConfig {
+    static_assert(Divider >= 1, "The divider must be at least 1");
+    static_assert(detail::timerInputDivider(Divider) != 0, "The divider must be a product of 1, 2, 4 or 8 and 1 to 8");
+
+    /// TBxCTL while stopped.
+    static constexpr uint16_t stoppedCtl = static_cast<uint16_t>(Source) | detail::timerIdBits(detail::timerInputDivider(Divider))
+                                         | static_cast<uint16_t>(Length) | (OverflowInterrupt ? TBIE : 0) | MC__STOP;
+    /// TBxCTL while running.
+    static constexpr uint16_t runningCtl = stoppedCtl | static_cast<uint16_t>(Mode);
+    /// TBxEX0, the second stage of the clock divider.
+    static constexpr uint16_t ex0 = (Divider / detail::timerInputDivider(Divider)) - 1;
+
+    /// Timer tick frequency in Hz, for a source clock of `sourceHz`.
+    static constexpr uint32_t tickHz(uint32_t sourceHz) {
+        return sourceHz / Divider;
+    }
+
+    /// CCR0 value (see TimerB::setPeriod()) for the timer to repeat at `periodHz`, for a source clock of `sourceHz`. Only meaningful in the up and up/down modes.
+    static constexpr uint16_t periodTicks(uint32_t sourceHz, uint32_t periodHz) {
+        return (Mode == TimerMode::UpDown) ? uint16_t(tickHz(sourceHz) / periodHz / 2)
+                                           : uint16_t(tickHz(sourceHz) / periodHz - 1);
+    }
+};
+
+//               Control  Count  Divider  Vector   First CCTL First CCR Channels
+#define TIMER_B0 &TB0CTL, &TB0R, &TB0EX0, &TB0IV, &TB0CCTL0, &TB0CCR0, 3
+#define TIMER_B1 &TB1CTL, &TB1R, &TB1EX0, &TB1IV, &TB1CCTL0, &TB1CCR0, 3
+#define TIMER_B2 &TB2CTL, &TB2R, &TB2EX0, &TB2IV, &TB2CCTL0, &TB2CCR0, 3
+#define TIMER_B3 &TB3CTL, &TB3R, &TB3EX0, &TB3IV, &TB3CCTL0, &TB3CCR0, 7
+
+/// A Timer_B instance. The capture/compare registers (TBxCCTLn and TBxCCRn) are consecutive in memory, so only the first of each is passed in,
+/// and channels are selected with a template parameter, e.g. `setCompare<2>(value)`.
+///
+/// CCR0 has its own interrupt vector (TIMERx_B0_VECTOR). The other channels and the overflow share TIMERx_B1_VECTOR, where pendingInterrupt()
+/// says which one fired:
+/// ```
+/// #pragma vector=TIMER1_B1_VECTOR
+/// __interrupt void TIMER1_B1_ISR(void) {
+///     switch (TimerB<TIMER_B1>::pendingInterrupt()) {
+///         case 1: // CCR1
+///             break;
+///         case TimerB<TIMER_B1>::overflowInterrupt:
+///             break;
+///     }
+/// }
+/// ```
+template<
+    volatile uint16_t* CTL,
+    volatile uint16_t* R,
+    volatile uint16_t* EX0,
+    volatile uint16_t* IV,
+    volatile uint16_t* CCTL0,
+    volatile uint16_t* CCR0,
+    uint8_t Channels
+>
+struct TimerB {
+    /// Number of capture/compare channels (CCR0 included).
+    static constexpr uint8_t channels = Channels;
+
+    /// Returned by pendingInterrupt() for the overflow (TBIFG) interrupt.
+    static constexpr uint8_t overflowInterrupt = TBIV__TBIFG >> 1;
+
+    /// Configure the timer with a TimerConfig, stopped, with the count cleared. Channels are unaffected.
+    template<typename Config>
+    static void init() {
+        *CTL = Config::stoppedCtl | TBCLR;
+        *EX0 = Config::ex0;
+    }
+
+    /// Start counting, in the mode of `Config` (which must match the one passed to init()). A single register write, which also clears a pending overflow flag.
+    template<typename Config>
+    static void start() {
+        *CTL = Config::runningCtl;
+    }
+
+    /// Stop counting, keeping the count. A single register write, which also clears a pending overflow flag.
+    template<typename Config>
+    static void stop() {
+        *CTL = Config::stoppedCtl;
+    }
+
+    /// Returns true if the timer is counting.
+    static bool isRunning() {
+        return (*CTL & MC) != MC__STOP;
+    }
+
+    /// Reset the count to zero. In up/down mode this also makes the timer count up.
+    static void clear() {
+        SET_BITS(CTL, TBCLR);
+    }
+
+    /// The current count. Reads until two consecutive reads agree, so it is also correct when the timer's clock is asynchronous to MCLK.
+    static uint16_t count() {
+        uint16_t a;
+        uint16_t b;
+        do {
+            a = *R;
+            b = *R;
+        } while (a != b);
+        return a;
+    }
+
+    /// Set CCR0, which sets the period in up and up/down modes (see TimerConfig::periodTicks()).
+    static void setPeriod(uint16_t ccr0) {
+        *CCR0 = ccr0;
+    }
+
+    static void enableOverflowInterrupt() {
+        CLEAR_BITS(CTL, TBIFG);
+        SET_BITS(CTL, TBIE);
+    }
+
+    static void disableOverflowInterrupt() {
+        CLEAR_BITS(CTL, TBIE);
+    }
+
+    /// Returns true if the count has overflowed (wrapped to 0) since the overflow flag was last cleared, e.g. by its interrupt.
+    static bool overflowFlagSet() {
+        return IS_SET(CTL, TBIFG);
+    }
+
+    /// Call this from the TIMERx_B1 interrupt. Returns the channel whose interrupt fired (1 to 6), overflowInterrupt, or 0 if none are pending.
+    /// Reading clears the flag of the returned interrupt. Only the highest priority pending interrupt is returned: any others fire again afterwards.
+    static uint8_t pendingInterrupt() {
+        return uint8_t(*IV >> 1);
+    }
+
+    /// Channel `n`'s control register (TBxCCTLn), for drivers that work on all of the channels at once. Prefer the functions below.
+    static volatile uint16_t* controlRegister(uint8_t n) {
+        return CCTL0 + n;
+    }
+
+    /// Channel `n`'s capture/compare register (TBxCCRn), for drivers that work on all of the channels at once. Prefer the functions below.
+    static volatile uint16_t* compareRegister(uint8_t n) {
+        return CCR0 + n;
+    }
+
+    /* Compare functions */
+    /// Set the compare value of channel `N`.
+    template<uint8_t N>
+    static void setCompare(uint16_t value) {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        CCR0[N] = value;
+    }
+
+    /// Put channel `N` in compare mode, driving its output with `mode`. Use PinFunction to connect the output to a pin.
+    template<uint8_t N>
+    static void setOutputMode(TimerOutputMode mode) {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        CCTL0[N] = (CCTL0[N] & ~(CAP | OUTMOD)) | static_cast<uint16_t>(mode);
+    }
+
+    /// Set channel `N`'s output directly, in TimerOutputMode::Output.
+    template<uint8_t N>
+    static void setOutput(bool high) {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        if (high) {
+            SET_BITS(CCTL0 + N, OUT);
+        } else {
+            CLEAR_BITS(CCTL0 + N, OUT);
+        }
+    }
+
+    /// Enable channel `N`'s interrupt, which fires on each compare match (or capture). Clears any old flag first.
+    template<uint8_t N>
+    static void enableInterrupt() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        CLEAR_BITS(CCTL0 + N, CCIFG);
+        SET_BITS(CCTL0 + N, CCIE);
+    }
+
+    template<uint8_t N>
+    static void disableInterrupt() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        CLEAR_BITS(CCTL0 + N, CCIE);
+    }
+
+    /// Returns true if channel `N` has matched (or captured) since its flag was last cleared.
+    template<uint8_t N>
+    static bool flagSet() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        return IS_SET(CCTL0 + N, CCIFG);
+    }
+
+    template<uint8_t N>
+    static void clearFlag() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        CLEAR_BITS(CCTL0 + N, CCIFG);
+    }
+
+    /* Capture functions */
+    /// Put channel `N` in capture mode: on each `edge` of `input`, the count is copied into CCRn and the flag (and interrupt, if enabled) is set.
+    /// Captures are synchronised to the timer clock. Use PinFunction to connect a pin to the A or B input.
+    template<uint8_t N>
+    static void configureCapture(CaptureEdge edge, CaptureInput input = CaptureInput::A) {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        CCTL0[N] = (CCTL0[N] & CCIE) | static_cast<uint16_t>(edge) | static_cast<uint16_t>(input) | SCS | CAP;
+    }
+
+    /// The count at the last capture on channel `N`.
+    template<uint8_t N>
+    static uint16_t capturedValue() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        return CCR0[N];
+    }
+
+    /// The current level of channel `N`'s capture input (CCI). This is the live input, not a copy taken at the capture, so after a capture on
+    /// both edges it only says which edge that was if the input can't have changed again since: check that flagSet<N>() is still false after reading it.
+    template<uint8_t N>
+    static bool captureInput() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        return IS_SET(CCTL0 + N, CCI);
+    }
+
+    /// Returns true if a capture happened on channel `N` before the previous one was read (its flag wasn't cleared in time), and clears the overflow.
+    template<uint8_t N>
+    static bool captureOverflowed() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        bool overflowed = IS_SET(CCTL0 + N, COV);
+        CLEAR_BITS(CCTL0 + N, COV);
+        return overflowed;
+    }
+
+    /// Trigger a capture on channel `N` from software, by toggling its input between Gnd and Vcc.
+    /// The channel must have been configured with CaptureInput::Gnd or CaptureInput::Vcc, and CaptureEdge::Both.
+    template<uint8_t N>
+    static void softwareCapture() {
+        static_assert(N < Channels, "This timer doesn't have that many channels");
+        TOGGLE_BITS(CCTL0 + N, CCIS0);
+    }
+};
+
+#endif /* TIMER_B_HPP */
@@ -0,0 +1,274 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "delay.hpp"
+
+/// A virtual timer, run by a TimerWheel. Declare one for each timeout, e.g. `SoftTimer retransmitTimer = {&onRetransmit};`, and keep it alive
+/// (e.g. as a global) while it's scheduled: the wheel links timers together rather than copying them, so it needs no storage of its own.
+struct SoftTimer {
+    /// Called from TimerWheel::poll() when the timer expires.
+    void (*callback)(SoftTimer& timer);
+
+    // Managed by the TimerWheel
+    SoftTimer* next;
+    SoftTimer* prev;
+    /// The Timebase tick count the timer expires at
+    uint32_t expiry;
+    /// Ticks between expiries for periodic timers, or 0 for one-shot timers
+    uint32_t period;
+    bool scheduled;
+};
+
+/// Runs any number of SoftTimers from the Timebase, using a single compare register (the Timebase alarm, so only use one TimerWheel).
+/// Timers are hashed by expiry time into 2^SlotBits slots, each 2^SlotWidthBits ticks wide, so the wheel turns once every 2^(SlotBits + SlotWidthBits) ticks.
+/// Scheduling and cancelling are O(1), and can be done from interrupts. Each slot is a linked list, and timers expiring further away than one turn
+/// of the wheel share a slot with nearer ones, and are skipped until their turn comes.
+///
+/// The wheel is tickless: instead of waking every slot, the alarm is set for the next expiry (or at most the end of the next occupied slot),
+/// so the CPU can stay in LPM3 in between. Timer expiries are exact to the tick (~30.5us), plus however long the main loop takes to call poll().
+/// ```
+/// Timebase::start();
+/// TimerWheel<>::schedule(retransmitTimer, Timebase::ticksForMs(200));
+/// while (1) {
+///     TimerWheel<>::poll();   // Runs expired callbacks
+///     TimerWheel<>::sleep();  // LPM3 until the next expiry (or any other interrupt that wakes the CPU)
+/// }
+/// ```
+/// Larger wheels spend more RAM (2 bytes per slot) to scan fewer slots when looking for the next expiry.
+/// The default (64 slots of 128 ticks) turns every 250ms, with 128 bytes of slots.
+template<uint8_t SlotBits = 6, uint8_t SlotWidthBits = 7>
+struct TimerWheel {
+    static_assert((SlotBits >= 4) && (SlotBits <= 10), "The wheel must have between 16 and 1024 slots");
+    static_assert(SlotWidthBits <= 15, "Slots can be at most 2^15 ticks wide");
+
+    /// Number of slots.
+    static constexpr uint16_t slots = uint16_t(1) << SlotBits;
+    /// Width of each slot in ticks.
+    static constexpr uint32_t slotWidth = uint32_t(1) << SlotWidthBits;
+
+    private:
+    static constexpr uint16_t slotMask = slots - 1;
+
+    struct State {
+        SoftTimer* heads[slots];
+        /// One bit per slot, set while the slot's list isn't empty
+        uint16_t occupied[slots / 16];
+        /// The start of the slot that poll() will look at first. Never ahead of the tick count.
+        uint32_t cursor;
+        /// The next timer to visit while poll() walks a slot, kept valid if that timer is unlinked in the meantime
+        SoftTimer* walkNext;
+        uint16_t count;
+    };
+    static State s;
+
+    static uint16_t slotOf(uint32_t tick) {
+        return uint16_t(tick >> SlotWidthBits) & slotMask;
+    }
+
+    static uint32_t slotStart(uint32_t tick) {
+        return tick & ~(slotWidth - 1);
+    }
+
+    /// Add a timer to the head of its slot. Interrupts must be disabled.
+    static void link(SoftTimer& timer) {
+        uint16_t slot = slotOf(timer.expiry);
+        if (s.count == 0) {
+            // Nothing to walk through, so skip the cursor straight to now
+            s.cursor = slotStart(Timebase::now());
+        }
+        timer.prev = nullptr;
+        timer.next = s.heads[slot];
+        if (timer.next) {
+            timer.next->prev = &timer;
+        }
+        s.heads[slot] = &timer;
+        s.occupied[slot >> 4] |= uint16_t(1) << (slot & 15);
+        timer.scheduled = true;
+        s.count++;
+    }
+
+    /// Remove a timer from its slot. Interrupts must be disabled.
+    static void unlink(SoftTimer& timer) {
+        uint16_t slot = slotOf(timer.expiry);
+        if (s.walkNext == &timer) {
+            s.walkNext = timer.next;
+        }
+        if (timer.prev) {
+            timer.prev->next = timer.next;
+        } else {
+            s.heads[slot] = timer.next;
+            if (!timer.next) {
+                s.occupied[slot >> 4] &= ~(uint16_t(1) << (slot & 15));
+            }
+        }
+        if (timer.next) {
+            timer.next->prev = timer.prev;
+        }
+        timer.scheduled = false;
+        s.count--;
+    }
+
+    /// Set the alarm for `expiry` if nothing sooner is already waiting. Interrupts must be disabled.
+    static void armFor(uint32_t expiry) {
+        if (Timebase::alarmFired()) {
+            // poll() is about to run, and sets the alarm afterwards
+            return;
+        }
+        if (!Timebase::alarmArmed() || (int32_t(expiry - Timebase::alarmTick()) < 0)) {
+            Timebase::setAlarm(expiry);
+        }
+    }
+
+    /// Run the expired timers in one slot.
+    static void runSlot(uint16_t slot, uint32_t now) {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        SoftTimer* timer = s.heads[slot];
+        while (timer) {
+            s.walkNext = timer->next;
+            if (int32_t(now - timer->expiry) >= 0) {
+                unlink(*timer);
+                if (timer->period != 0) {
+                    // Reschedule before the callback, so the callback can cancel or reschedule it
+                    timer->expiry += timer->period;
+                    if (int32_t(now - timer->expiry) >= 0) {
+                        // poll() is late by whole periods. Skip them, keeping the phase: an expiry that was still due would be linked
+                        // into a slot the walk may have passed, and wouldn't be found until the wheel came round again.
+                        timer->expiry += ((now - timer->expiry) / timer->period + 1) * timer->period;
+                    }
+                    link(*timer);
+                }
+                // Let interrupts in while the callback runs. unlink() keeps walkNext valid if the callback (or an interrupt) removes it.
+                __set_interrupt_state(interruptState);
+                timer->callback(*timer);
+                __disable_interrupt();
+            }
+            timer = s.walkNext;
+        }
+        s.walkNext = nullptr;
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Number of slots from `from` to the next occupied slot (0 if `from` is occupied), or `slots` if every slot is empty.
+    static uint16_t distanceToOccupied(uint16_t from) {
+        uint16_t distance = 0;
+        while (distance < slots) {
+            uint16_t slot = (from + distance) & slotMask;
+            uint16_t bits = s.occupied[slot >> 4] >> (slot & 15);
+            if (bits == 0) {
+                // Skip the rest of this word
+                distance += 16 - (slot & 15);
+                continue;
+            }
+            while (!(bits & 1)) {
+                bits >>= 1;
+                distance++;
+            }
+            return (distance < slots) ? distance : slots;
+        }
+        return slots;
+    }
+
+    public:
+    /// Start (or restart) `timer`, to expire `delayTicks` ticks from now, and then every `periodTicks` ticks if that isn't 0.
+    /// Use Timebase::ticksForMs() to convert from milliseconds. The timer's callback must have been set.
+    /// If poll() is called so late that a periodic timer has missed more than one expiry, its callback runs once and the missed expiries are skipped.
+    static void schedule(SoftTimer& timer, uint32_t delayTicks, uint32_t periodTicks = 0) {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        if (timer.scheduled) {
+            unlink(timer);
+        }
+        timer.expiry = Timebase::now() + delayTicks;
+        timer.period = periodTicks;
+        link(timer);
+        armFor(timer.expiry);
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Stop `timer`, if it's scheduled. Its callback won't be called, even if it has already expired.
+    static void cancel(SoftTimer& timer) {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        if (timer.scheduled) {
+            unlink(timer);
+        }
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Returns true if `timer` is waiting to expire.
+    static bool isScheduled(const SoftTimer& timer) {
+        return timer.scheduled;
+    }
+
+    /// Number of scheduled timers.
+    static uint16_t scheduledCount() {
+        return s.count;
+    }
+
+    /// Run the callbacks of every expired timer, then set the alarm for the next expiry. Call this from the main loop, not an interrupt.
+    /// Slots are walked from where the last poll() stopped up to now, visiting each slot at most once, so a late poll() catches up in one call.
+    static void poll() {
+        Timebase::takeAlarm();
+        uint32_t now = Timebase::now();
+        while (true) {
+            #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+            for (uint16_t visited = 0; visited < slots; visited++) {
+                runSlot(slotOf(s.cursor), now);
+                if (int32_t(now - (s.cursor + slotWidth)) < 0) {
+                    break;
+                }
+                s.cursor += slotWidth;
+            }
+            #pragma diag_default 1544
+            // Every slot has been visited, or the cursor has caught up with now
+            if (int32_t(now - s.cursor) >= int32_t(slotWidth)) {
+                s.cursor = slotStart(now);
+            }
+
+            uint16_t interruptState = __get_interrupt_state();
+            __disable_interrupt();
+            uint16_t distance = distanceToOccupied(slotOf(s.cursor));
+            if (distance == slots) {
+                Timebase::cancelAlarm();
+                __set_interrupt_state(interruptState);
+                return;
+            }
+            // The next expiry is in the first occupied slot, unless every timer there is due on a later turn of the wheel.
+            // In that case, wake at the end of the slot and look further on.
+            uint32_t next = s.cursor + (uint32_t(distance) + 1) * slotWidth;
+            for (SoftTimer* timer = s.heads[(slotOf(s.cursor) + distance) & slotMask]; timer; timer = timer->next) {
+                if (int32_t(timer->expiry - next) < 0) {
+                    next = timer->expiry;
+                }
+            }
+            __set_interrupt_state(interruptState);
+
+            now = Timebase::now();
+            if (int32_t(now - next) < 0) {
+                Timebase::setAlarm(next);
+                return;
+            }
+            // Already due (a callback took a while, or a timer was scheduled with no delay), so go round again
+        }
+    }
+
+    /// Sleep in the low power mode given by `lpmBits` until the alarm fires (or another interrupt wakes the CPU).
+    /// Returns straight away if the alarm has already fired, so an expiry between poll() and sleep() isn't missed.
+    static void sleep(uint16_t lpmBits = LPM3_bits) {
+        __disable_interrupt();
+        if (Timebase::alarmFired()) {
+            __enable_interrupt();
+            return;
+        }
+        __bis_SR_register(lpmBits | GIE);
+    }
+};
+
+template<uint8_t SlotBits, uint8_t SlotWidthBits>
+typename TimerWheel<SlotBits, SlotWidthBits>::State TimerWheel<SlotBits, SlotWidthBits>::s;
+
+#endif /* TIMER_WHEEL_HPP */
@@ -0,0 +1,33 @@
+#include <msp430.h>
+#include <stdint.h>
+
+#include "fram.hpp"
+#include "watchdog_supervisor.hpp"
+
+struct SupervisorRecord {
+    SupervisorFailure failure;
+    /// True from a failure being recorded until takeSupervisorFailure() reads it
+    bool pending;
+};
+
+// Kept in FRAM, so it survives the watchdog reset
+#pragma PERSISTENT(supervisorRecord)
+static SupervisorRecord supervisorRecord = {{0, 0, 0}, false};
+
+void detail::recordSupervisorFailure(uint8_t task, uint32_t timestamp) {
+    FramWriteEnable unlock;
+    supervisorRecord.failure.task = task;
+    supervisorRecord.failure.timestamp = timestamp;
+    supervisorRecord.failure.count++;
+    supervisorRecord.pending = true;
+}
+
+bool takeSupervisorFailure(SupervisorFailure& failure) {
+    if (!supervisorRecord.pending) {
+        return false;
+    }
+    failure = supervisorRecord.failure;
+    FramWriteEnable unlock;
+    supervisorRecord.pending = false;
+    return true;
+}
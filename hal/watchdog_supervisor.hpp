@@ -0,0 +1,166 @@
+#ifndef WATCHDOG_SUPERVISOR_HPP
+#define WATCHDOG_SUPERVISOR_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "watchdog.hpp"
+
+/// The task that caused the last supervisor reset, kept in FRAM so it survives the reset. Requires watchdog_supervisor.cpp to be part of the build.
+struct SupervisorFailure {
+    /// ID of the task that missed its deadline.
+    uint8_t task;
+    /// When the task was found to have failed, in supervisor checks since WatchdogSupervisor::start().
+    uint32_t timestamp;
+    /// Number of supervisor failures recorded since the device was programmed.
+    uint16_t count;
+};
+
+/// If a supervisor failure has been recorded since the last call, copy it into `failure`, forget it, and return true.
+/// Call this once at startup, e.g. to log which task caused the last watchdog reset.
+bool takeSupervisorFailure(SupervisorFailure& failure);
+
+// Internal implementation details
+namespace detail {
+    /// Store the culprit and timestamp in FRAM. Defined in watchdog_supervisor.cpp.
+    void recordSupervisorFailure(uint8_t task, uint32_t timestamp);
+}
+
+/// Only pats the watchdog while every watched task is healthy, so a stuck low priority task resets the device even though other code keeps running.
+/// Each task checks in with checkIn<Task>(), a single store, and must do so within its own deadline. Deadlines are counted in calls to check(),
+/// which must come from a periodic interrupt that doesn't depend on the tasks, e.g. a TimerWheel timer or the RTC:
+/// ```
+/// using Supervisor = WatchdogSupervisor<3>;
+/// Supervisor::start(WatchdogSource::Aclk, WatchdogCount::_32k); // Resets 1s after the last pat
+/// Supervisor::watch(0, 2);  // Radio task: at least once every 2 checks
+/// Supervisor::watch(1, 20); // Logging task: at least once every 20 checks
+///
+/// void radioTask() {
+///     ...
+///     Supervisor::checkIn<0>();
+/// }
+///
+/// #pragma vector=RTC_VECTOR
+/// __interrupt void RTC_ISR(void) {
+///     Rtc::handleInterrupt();
+///     Supervisor::check(); // Every 250ms
+/// }
+/// ```
+/// A task has failed when `deadline` checks in a row have passed without it checking in, so the allowed gap is between deadline - 1 and
+/// deadline check periods. When a task fails, its ID and the timestamp are recorded in FRAM, and the watchdog is left to expire and reset the device
+/// (so SYSRSTIV reports a watchdog timeout). Choose a watchdog interval comfortably longer than the check period.
+template<uint8_t TaskCount>
+struct WatchdogSupervisor {
+    static_assert(TaskCount > 0, "The supervisor needs at least one task");
+    // culprit() is an int8_t where -1 means healthy, so task IDs must be positive int8_t values
+    static_assert(TaskCount <= 127, "The supervisor supports at most 127 tasks");
+
+    private:
+    struct State {
+        /// Set by each task's check-in, and cleared by check()
+        volatile bool checkedIn[TaskCount];
+        /// Checks allowed between check-ins, or 0 if the task isn't watched
+        uint16_t deadline[TaskCount];
+        /// Checks left before the task fails
+        uint16_t remaining[TaskCount];
+        uint32_t checks;
+        /// The task that failed, or -1
+        volatile int8_t culprit;
+    };
+    static State s;
+
+    public:
+    /// Start the watchdog with the given interval, and stop watching every task. The watchdog is patted by check() from now on.
+    static void start(WatchdogSource clockSource, WatchdogCount count) {
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t task = 0; task < TaskCount; task++) {
+            s.deadline[task] = 0;
+        }
+        #pragma diag_default 1544
+        s.checks = 0;
+        s.culprit = -1;
+        Watchdog::config_as_watchdog(clockSource, count);
+    }
+
+    /// Start watching task `task`, which must check in at least once every `deadline` calls to check(). Does nothing if there is no such task.
+    static void watch(uint8_t task, uint16_t deadline) {
+        if (task >= TaskCount) {
+            return;
+        }
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        s.checkedIn[task] = false;
+        s.remaining[task] = deadline;
+        s.deadline[task] = deadline;
+        __set_interrupt_state(interruptState);
+    }
+
+    /// Stop watching task `task`, e.g. while it's deliberately idle. Does nothing if there is no such task.
+    static void unwatch(uint8_t task) {
+        if (task >= TaskCount) {
+            return;
+        }
+        s.deadline[task] = 0;
+    }
+
+    /// Report that task `Task` is making progress. A single store, so it's cheap enough to call from a task's inner loop.
+    template<uint8_t Task>
+    static void checkIn() {
+        static_assert(Task < TaskCount, "No such task");
+        s.checkedIn[Task] = true;
+    }
+
+    /// Report that task `task` is making progress. Does nothing if there is no such task.
+    static void checkIn(uint8_t task) {
+        if (task >= TaskCount) {
+            return;
+        }
+        s.checkedIn[task] = true;
+    }
+
+    /// Call this from a periodic interrupt. Counts down each watched task's deadline, and pats the watchdog if every task is healthy.
+    /// Returns true when a task has just failed, so the interrupt can wake the CPU (e.g. to flush a log) before the watchdog resets the device.
+    static bool check() {
+        if (s.culprit >= 0) {
+            // Already failed, and waiting for the watchdog
+            return false;
+        }
+        s.checks++;
+        #pragma diag_suppress 1544 // Suppress loop counting up remark. We can't count down here.
+        for (uint8_t task = 0; task < TaskCount; task++) {
+            if (s.deadline[task] == 0) {
+                continue;
+            }
+            if (s.checkedIn[task]) {
+                s.checkedIn[task] = false;
+                s.remaining[task] = s.deadline[task];
+            } else if (--s.remaining[task] == 0) {
+                s.culprit = task;
+                detail::recordSupervisorFailure(task, s.checks);
+                return true;
+            }
+        }
+        #pragma diag_default 1544
+        Watchdog::pat();
+        return false;
+    }
+
+    /// The task that failed, or -1 if every task is healthy.
+    static int8_t culprit() {
+        return s.culprit;
+    }
+
+    /// Number of calls to check() since start().
+    static uint32_t checks() {
+        uint16_t interruptState = __get_interrupt_state();
+        __disable_interrupt();
+        uint32_t checks = s.checks;
+        __set_interrupt_state(interruptState);
+        return checks;
+    }
+};
+
+template<uint8_t TaskCount>
+typename WatchdogSupervisor<TaskCount>::State WatchdogSupervisor<TaskCount>::s;
+
+#endif /* WATCHDOG_SUPERVISOR_HPP */
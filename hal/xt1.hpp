@@ -0,0 +1,106 @@
+#ifndef XT1_HPP
+#define XT1_HPP
+
+#include <msp430.h>
+#include <stdint.h>
+
+#include "gpio.hpp"
+#include "clock.hpp"
+
+/// A 32.768kHz watch crystal on XT1 (XIN = P2.7, XOUT = P2.6).
+/// REFO is only accurate to about +-3.5%, which limits UART baud rates and long term timing. A crystal is typically accurate to +-20ppm.
+/// Once started, use it as the FLL reference and ACLK with `ClockConfig<..., FllReference::Xt1>`.
+///
+/// If the crystal fails later (e.g. it is damaged or shorted), the oscillator fault interrupt switches the FLL and ACLK back to REFO.
+/// To use this, call enableFaultInterrupt() and forward the user NMI to handleFaultInterrupt():
+/// ```
+/// #pragma vector=UNMI_VECTOR
+/// __interrupt void UNMI_ISR(void) {
+///     if (Xt1::handleFaultInterrupt()) {
+///         __bic_SR_register_on_exit(LPM3_bits); // Fallen back to REFO, wake the CPU to deal with it
+///     }
+/// }
+/// ```
+struct Xt1 {
+    private:
+    struct State {
+        volatile bool fellBack;
+        volatile uint16_t faults;
+    };
+
+    static State& state() {
+        static State s = {};
+        return s;
+    }
+
+    /// Clear the oscillator fault flags. They are set again straight away while the fault persists.
+    static void clearFaults() {
+        CSCTL7 &= ~(XT1OFFG | DCOFFG);
+        SFRIFG1 &= ~OFIFG;
+    }
+
+    public:
+    /// Start the crystal, and wait for it to oscillate reliably. Configures P2.6 and P2.7 for the crystal. gpioUnlock() must have been called.
+    /// Crystals can take hundreds of milliseconds to start, so the fault flags are cleared and checked up to `maxAttempts` times.
+    /// Returns true if the crystal is running. On false the crystal is switched off again and the clocks are unaffected.
+    static bool start(uint16_t maxAttempts = 10000) {
+        Pin<P2,6>::function(PinFunction::Secondary);
+        Pin<P2,7>::function(PinFunction::Secondary);
+
+        //       Low frequency mode | Full drive strength for startup | Don't turn off while unused
+        CSCTL6 = (CSCTL6 & ~(XTS | XT1DRIVE | XT1AUTOOFF)) | XTS_0 | XT1DRIVE_3;
+        do {
+            clearFaults();
+            if (maxAttempts-- == 0) {
+                CSCTL6 |= XT1AUTOOFF;
+                return false;
+            }
+        } while (SFRIFG1 & OFIFG);
+
+        // Once running, the lowest drive strength is enough and uses the least power
+        CSCTL6 = (CSCTL6 & ~XT1DRIVE) | XT1DRIVE_0;
+        state().fellBack = false;
+        return true;
+    }
+
+    /// Enable the oscillator fault interrupt (a user NMI), so a crystal failure is handled by handleFaultInterrupt().
+    static void enableFaultInterrupt() {
+        clearFaults();
+        SFRIE1 |= OFIE;
+    }
+
+    /// Call this from the user NMI interrupt. If the crystal has failed, the FLL reference and ACLK are switched to REFO,
+    /// the oscillator fault interrupt is disabled (it would otherwise fire continuously), and true is returned.
+    /// REFO has the same nominal frequency, so everything keeps running with REFO's accuracy. Call start() to try the crystal again.
+    static bool handleFaultInterrupt() {
+        switch (__even_in_range(SYSUNIV, SYSUNIV__OFIFG)) {
+            case SYSUNIV__OFIFG:
+                if (!(CSCTL7 & XT1OFFG)) {
+                    // A DCO fault. The FLL recovers from these by itself.
+                    clearFaults();
+                    return false;
+                }
+                CSCTL3 = (CSCTL3 & ~SELREF) | SELREF__REFOCLK;
+                CSCTL4 = (CSCTL4 & ~SELA) | SELA__REFOCLK;
+                SFRIE1 &= ~OFIE;
+                clearFaults();
+                state().faults++;
+                state().fellBack = true;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /// Returns true if the clocks have fallen back to REFO because the crystal failed.
+    static bool hasFallenBack() {
+        return state().fellBack;
+    }
+
+    /// Number of crystal failures handled since reset.
+    static uint16_t faultCount() {
+        return state().faults;
+    }
+};
+
+#endif /* XT1_HPP */